@@ -7,36 +7,12 @@
 # 0 3
 # 0 4
 # EOF
-puts '<svg xmlns="http://www.w3.org/2000/svg" version="1.1" width="440px" height="440px">'
-
-f = ->x { STDIN.gets.split.map &x }
-n, m = f[:to_i]
-es = m.times.map { f[:to_i] }
-coords = nil
+# Kept for existing callers; the same as force --output-format svg.
 
 dirs = ['.', 'src', '../src']
 dir = dirs[0]
 dirs.each do |d|
-  dir = d if File.exists? File.join d, 'force'
-end
-
-IO.popen [File.join(dir, 'force'), *ARGV], 'r+' do |io|
-  io.puts "#{n} #{m}"
-  es.each {|e| io.puts e.join ' ' }
-  io.close_write
-  coords = n.times.map { io.gets.split.map &:to_f }
-end
-
-n.times do |i|
-  x, y = coords[i]
-  puts %Q{<circle cx="#{x+20}" cy="#{y+20}" r="5" fill="black"/>}
-  puts %Q{<text x="#{x+25}" y="#{y+20}" fill="red">#{i}</text>}
-end
-
-m.times do |i|
-  x, y = coords[es[i][0]]
-  xx, yy = coords[es[i][1]]
-  puts %Q{<line x1="#{x+20}" y1="#{y+20}" x2="#{xx+20}" y2="#{yy+20}" stroke="black"/>}
+  dir = d if File.exist? File.join d, 'force'
 end
 
-puts '</svg>'
+exec File.join(dir, 'force'), '--output-format', 'svg', *ARGV
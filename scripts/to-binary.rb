@@ -0,0 +1,17 @@
+#!/usr/bin/env ruby
+# Convert a graph from the text format to the binary one (force --input-format binary)
+# ./to-binary.rb [-w] < graph.txt > graph.bin
+#   -w: the text has a weight on every edge
+weighted = ARGV.include? '-w'
+
+tokens = STDIN.read.split
+n, m = tokens.shift(2).map &:to_i
+width = weighted ? 3 : 2
+es = tokens.first(m * width).each_slice(width).to_a
+abort 'truncated input' if es.size < m
+
+STDOUT.binmode
+STDOUT.write ['FDGB', weighted ? 1 : 0, n, m].pack('a4LQQ')
+STDOUT.write es.map {|e| e[0].to_i }.pack('l*')
+STDOUT.write es.map {|e| e[1].to_i }.pack('l*')
+STDOUT.write es.map {|e| e[2].to_f }.pack('d*') if weighted
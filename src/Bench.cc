@@ -0,0 +1,236 @@
+// Wall time, peak memory and layout quality of the layout engines on
+// synthetic graphs; see force-bench --help
+#include <chrono>
+#include <memory>
+#include <string>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "Core.hh"
+#include "Circle.hh"
+#include "FruchtermanReingold.hh"
+#include "Walshaw.hh"
+#include "LinLog.hh"
+#include "ForceAtlas2.hh"
+#include "MultilevelWalshaw.hh"
+#include "KamadaKawai.hh"
+#include "StressMajorization.hh"
+#include "ShortestPath.hh"
+#include "Generators.hh"
+#include "BenchCmdline.h"
+
+typedef Vector<double, 2> V;
+
+// What a child sends back over its pipe
+struct Result
+{
+  int m, iterations;
+  double seconds, edge_cv, stress;
+};
+
+static vector<std::string> split(const char* s)
+{
+  vector<std::string> r;
+  for (const char* p = s; ; p++) {
+    const char* q = strchr(p, ',');
+    if (! q) q = p + strlen(p);
+    if (q > p) r.push_back(std::string(p, q));
+    if (! *q) break;
+    p = q;
+  }
+  return r;
+}
+
+static ForceDirectedDrawing<double, 2>* makeEngine(const std::string& name, const array<double, 2>& space, int iterations)
+{
+  if (name == "circle")
+    return new Circle<double, 2>(space);
+  if (name == "fr" || name == "fr-exact") {
+    auto a = new FruchtermanReingold<double, 2>(space);
+    a->iterations = iterations;
+    a->repulsion.method = name == "fr" ? REPULSION_KDTREE : REPULSION_EXACT;
+    return a;
+  }
+  if (name == "walshaw") {
+    auto a = new Walshaw<double, 2>(space);
+    a->iterations = iterations;
+    return a;
+  }
+  if (name == "linlog") {
+    auto a = new LinLog<double, 2>(space);
+    a->iterations = iterations;
+    return a;
+  }
+  if (name == "fa2") {
+    auto a = new ForceAtlas2<double, 2>(space);
+    a->iterations = iterations;
+    return a;
+  }
+  if (name == "multilevel") {
+    auto a = new MultilevelWalshaw<double, 2>(space);
+    a->iterations = iterations;
+    return a;
+  }
+  if (name == "kk")
+    return new KamadaKawai<double, 2>(space);
+  if (name == "stress") {
+    auto a = new StressMajorization<double, 2>(space);
+    a->iterations = iterations;
+    return a;
+  }
+  return NULL;
+}
+
+// standard deviation over mean of the edge lengths
+static double edgeCV(const Graph<double>& g, const vector<V>& pos)
+{
+  double s = 0, s2 = 0;
+  int m = 0;
+  for (int u = 0; u < g.n; u++)
+    for (int j = g.offset[u]; j < g.offset[u + 1]; j++)
+      if (u < g.adj[j]) {
+        double l = pos[u].dist(pos[g.adj[j]]);
+        s += l;
+        s2 += l * l;
+        m++;
+      }
+  if (m == 0 || s == 0) return 0;
+  double mean = s / m;
+  return sqrt(max(0.0, s2 / m - mean * mean)) / mean;
+}
+
+// Normalized stress sum w (s * |x_u - x_v| - d_uv)^2 / #pairs with
+// w = 1 / d_uv^2, over the pairs from up to `sources' evenly spaced
+// vertices. The scale s minimizing it is taken, so the unit does not matter.
+static double sampledStress(const Graph<double>& g, const vector<V>& pos, int sources)
+{
+  vector<double> dist;
+  vector<int> queue;
+  // with w = 1 / d^2, stress(s) = s^2 sum l^2 / d^2 - 2 s sum l / d + #pairs
+  double a = 0, b = 0;
+  long pairs = 0;
+  int step = max(1, g.n / max(sources, 1));
+  for (int s = 0; s < g.n; s += step) {
+    bfs(g, s, 1.0, dist, queue);
+    for (int v = 0; v < g.n; v++)
+      if (v != s && dist[v] != numeric_limits<double>::max()) {
+        double l = pos[s].dist(pos[v]);
+        a += l * l / (dist[v] * dist[v]);
+        b += l / dist[v];
+        pairs++;
+      }
+  }
+  if (pairs == 0) return 0;
+  if (a == 0) return 1;
+  return (pairs - b * b / a) / pairs;
+}
+
+static Result run(GraphFamily family, int n, unsigned seed, const std::string& engine, int threads, int iterations)
+{
+  Graph<double> g = generateGraph<double>(family, n, seed);
+  array<double, 2> space = {{400, 400}};
+  vector<V> pos(g.n);
+  Circle<double, 2> circle(space);
+  circle(g, pos);
+  std::unique_ptr<ForceDirectedDrawing<double, 2>> algo(makeEngine(engine, space, iterations));
+  algo->threads = threads;
+  auto start = std::chrono::steady_clock::now();
+  (*algo)(g, pos);
+  Result r;
+  r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  r.m = g.offset[g.n] / 2;
+  r.iterations = algo->iterations_run;
+  r.edge_cv = edgeCV(g, pos);
+  r.stress = sampledStress(g, pos, 50);
+  return r;
+}
+
+// Runs in a child so that every measurement gets its own peak RSS. The child
+// is killed after `timeout' seconds (0: never). False if it failed.
+static bool measure(GraphFamily family, int n, unsigned seed, const std::string& engine, int threads, int iterations, unsigned timeout, Result& r, long& rss_kb)
+{
+  int fd[2];
+  if (pipe(fd) < 0)
+    return false;
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid < 0)
+    return false;
+  if (pid == 0) {
+    close(fd[0]);
+    alarm(timeout);
+    Result r = run(family, n, seed, engine, threads, iterations);
+    _exit(write(fd[1], &r, sizeof r) == sizeof r ? 0 : 1);
+  }
+  close(fd[1]);
+  bool ok = read(fd[0], &r, sizeof r) == sizeof r;
+  close(fd[0]);
+  int status;
+  struct rusage usage;
+  if (wait4(pid, &status, 0, &usage) < 0)
+    return false;
+  rss_kb = usage.ru_maxrss;
+  return ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int main(int argc, char* argv[])
+{
+  gengetopt_args_info args_info;
+  if (cmdline_parser(argc, argv, &args_info) != 0)
+    return 1;
+
+  vector<GraphFamily> families;
+  for (auto& s : split(args_info.graphs_arg)) {
+    GraphFamily f;
+    if (! parseGraphFamily(s.c_str(), f)) {
+      fprintf(stderr, "unknown graph family: %s\n", s.c_str());
+      return 1;
+    }
+    families.push_back(f);
+  }
+  vector<std::string> engines = split(args_info.engines_arg);
+  array<double, 2> space = {{400, 400}};
+  for (auto& e : engines) {
+    std::unique_ptr<ForceDirectedDrawing<double, 2>> algo(makeEngine(e, space, 0));
+    if (! algo) {
+      fprintf(stderr, "unknown engine: %s\n", e.c_str());
+      return 1;
+    }
+  }
+  vector<int> sizes, threads;
+  for (auto& s : split(args_info.sizes_arg))
+    sizes.push_back(atoi(s.c_str()));
+  for (auto& s : split(args_info.threads_arg))
+    threads.push_back(max(1, atoi(s.c_str())));
+  bool json = ! strcmp(args_info.format_arg, "json");
+
+  static const char* names[] = {"grid", "rgg", "ba", "tree", "union"};
+  bool first = true;
+  printf(json ? "[\n" : "graph,n,m,engine,threads,seconds,peak_rss_kb,iterations,edge_cv,stress\n");
+  int failed = 0;
+  for (GraphFamily f : families)
+    for (int n : sizes)
+      for (auto& e : engines)
+        for (int t : threads) {
+          Result r;
+          long rss;
+          if (! measure(f, n, args_info.seed_arg, e, t, args_info.iterations_arg, max(0, args_info.timeout_arg), r, rss)) {
+            fprintf(stderr, "%s n=%d %s threads=%d failed\n", names[f], n, e.c_str(), t);
+            failed++;
+            continue;
+          }
+          if (json)
+            printf("%s  {\"graph\": \"%s\", \"n\": %d, \"m\": %d, \"engine\": \"%s\", \"threads\": %d, \"seconds\": %.6f, \"peak_rss_kb\": %ld, \"iterations\": %d, \"edge_cv\": %.6f, \"stress\": %.6f}",
+                   first ? "" : ",\n", names[f], n, r.m, e.c_str(), t, r.seconds, rss, r.iterations, r.edge_cv, r.stress);
+          else
+            printf("%s,%d,%d,%s,%d,%.6f,%ld,%d,%.6f,%.6f\n", names[f], n, r.m, e.c_str(), t, r.seconds, rss, r.iterations, r.edge_cv, r.stress);
+          first = false;
+          fflush(stdout);
+        }
+  if (json)
+    printf("%s]\n", first ? "" : "\n");
+
+  cmdline_parser_free(&args_info);
+  return failed ? 2 : 0;
+}
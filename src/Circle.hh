@@ -11,13 +11,19 @@ struct Circle : ForceDirectedDrawing<T, Dim>
 
   Circle(const array<T, Dim>& space)
     : ForceDirectedDrawing<T, Dim>(space) {}
+  virtual Circle* clone() const { return new Circle(*this); }
   virtual void operator()(const Graph<T>& g, vector<Vector<T, Dim>>& pos) {
+    STATS_PHASE(PHASE_INIT);
     for (int u = 0; u < g.n; u++) {
       T angle = 2 * M_PI * u / g.n;
       for (size_t dim = 0; dim < Dim; dim++)
         pos[u][dim] = space[dim] / 2;
       pos[u][0] += space[0] * std::cos(angle);
       pos[u][1] += space[1] * std::sin(angle);
+      // further coordinates bend the circle out of the plane, which forces
+      // would otherwise never leave
+      for (size_t dim = 2; dim < Dim; dim++)
+        pos[u][dim] += space[dim] / 2 * std::sin(angle * dim);
     }
   }
 };
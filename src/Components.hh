@@ -0,0 +1,282 @@
+#ifndef COMPONENTS_HH
+#define COMPONENTS_HH
+
+#include <atomic>
+#include <memory>
+#include "Core.hh"
+#include "Circle.hh"
+#include "Control.hh"
+#include "Parallel.hh"
+
+// comp[u]: connected component of u, numbered by first vertex; returns the
+// number of components. `queue' is scratch.
+template<typename T>
+int connectedComponents(const Graph<T>& g, vector<int>& comp, vector<int>& queue)
+{
+  comp.assign(g.n, -1);
+  queue.resize(g.n);
+  int count = 0;
+  for (int s = 0; s < g.n; s++)
+    if (comp[s] < 0) {
+      int head = 0, tail = 0;
+      comp[s] = count;
+      queue[tail++] = s;
+      while (head < tail) {
+        int u = queue[head++];
+        for (int j = g.offset[u]; j < g.offset[u + 1]; j++)
+          if (comp[g.adj[j]] < 0) {
+            comp[g.adj[j]] = count;
+            queue[tail++] = g.adj[j];
+          }
+      }
+      count++;
+    }
+  return count;
+}
+
+template<typename T>
+int connectedComponents(const Graph<T>& g, vector<int>& comp)
+{
+  vector<int> queue;
+  return connectedComponents(g, comp, queue);
+}
+
+// Lays out each connected component on its own with `engine', in a share of
+// the space proportional to its number of vertices so that all get the same
+// ideal edge length, then packs the components' boxes on shelves (rows of
+// boxes of decreasing height) and fits the whole to the space.
+// Components much smaller than the graph are laid out concurrently, a
+// thread each; the others one after another with all threads. Unless the
+// start is warm, the positions passed in are ignored: each component, or a
+// connected graph, starts from `initial' (a circle by default), so callers
+// need not lay out the whole graph first. A warm start goes to the engine as
+// it is. The control applies to every component, but progress is only
+// reported for a graph that goes to the engine whole.
+template<typename T, size_t Dim>
+struct ComponentLayout : ForceDirectedDrawing<T, Dim>
+{
+  static_assert(Dim >= 2, "components are packed in the plane");
+  using ForceDirectedDrawing<T, Dim>::space;
+  using ForceDirectedDrawing<T, Dim>::threads;
+
+  // takes ownership of `engine' and `initial'
+  ComponentLayout(ForceDirectedDrawing<T, Dim>* engine, ForceDirectedDrawing<T, Dim>* initial = NULL)
+    : ForceDirectedDrawing<T, Dim>(engine->space)
+      , engine(engine)
+      , initial(initial ? initial : new Circle<T, Dim>(engine->space)) {}
+  ComponentLayout(const ComponentLayout& r)
+    : ForceDirectedDrawing<T, Dim>(r)
+      , engine(r.engine->clone())
+      , initial(r.initial->clone()) {}
+  virtual ComponentLayout* clone() const { return new ComponentLayout(*this); }
+  virtual void operator()(const Graph<T>& g, vector<Vector<T, Dim>>& pos) {
+    int count = connectedComponents(g, comp, queue);
+    if (count <= 1 || this->warm) {
+      engine->space = space;
+      engine->threads = threads;
+      engine->warm = this->warm;
+      engine->mobilities = this->mobilities;
+      engine->control = this->control;
+      if (! this->warm) {
+        initial->space = space;
+        initial->threads = threads;
+        (*initial)(g, pos);
+      }
+      (*engine)(g, pos);
+      this->iterations_run = engine->iterations_run;
+      this->interrupted = engine->interrupted;
+      this->error = engine->error;
+      return;
+    }
+
+    // members of component c are member[first[c]..first[c + 1]) in
+    // increasing order, so a vertex's number within its component is its
+    // rank there; components go largest first, of one size by number
+    first.assign(count + 1, 0);
+    for (int u = 0; u < g.n; u++)
+      first[comp[u] + 1]++;
+    for (int c = 0; c < count; c++)
+      first[c + 1] += first[c];
+    fill.assign(first.begin(), first.end() - 1);
+    member.resize(g.n);
+    local.resize(g.n);
+    for (int u = 0; u < g.n; u++) {
+      local[u] = fill[comp[u]] - first[comp[u]];
+      member[fill[comp[u]]++] = u;
+    }
+    by_size.resize(count);
+    for (int c = 0; c < count; c++)
+      by_size[c] = c;
+    auto size = [&](int c) { return first[c + 1] - first[c]; };
+    std::sort(by_size.begin(), by_size.end(), [&](int a, int b) { return size(a) != size(b) ? size(a) > size(b) : a < b; });
+    if (parts.size() < size_t(count)) {
+      parts.resize(count, Graph<T>(0));
+      layouts.resize(count);
+    }
+    passes.assign(count, 0);
+    stopped.assign(count, 0);
+    errors.assign(count, 0);
+    // the parts start cold, whatever a warm call left the engine with
+    engine->warm = false;
+    engine->mobilities.clear();
+    if (this->control) {
+      quiet.deadline = this->control->deadline;
+      quiet.cancel = this->control->cancel;
+      engine->control = &quiet;
+    } else
+      engine->control = NULL;
+    parallelFor(threads, count, [&](int c) {
+      subgraph(g, &member[first[by_size[c]]], size(by_size[c]), local, parts[c]);
+    }, 64);
+
+    // one thread can handle a component at most 1 / threads of the graph
+    int big = 0;
+    while (big < count && threads > 1 && size(by_size[big]) * threads >= g.n)
+      big++;
+    for (int c = 0; c < big; c++) {
+      engine->threads = initial->threads = threads;
+      passes[c] = layoutPart(*engine, *initial, parts[c], g.n, layouts[c]);
+      stopped[c] = engine->interrupted;
+      errors[c] = engine->error;
+    }
+    // the first worker is the caller's thread with the engine itself, the
+    // others have copies
+    std::atomic<int> next(big);
+    engine->interrupted = false;
+    parallelRun(min(threads, count - big), [&](int w) {
+      std::unique_ptr<ForceDirectedDrawing<T, Dim>> copy, init_copy;
+      if (w) {
+        copy.reset(engine->clone());
+        init_copy.reset(initial->clone());
+      }
+      ForceDirectedDrawing<T, Dim> &e = w ? *copy : *engine, &init = w ? *init_copy : *initial;
+      e.threads = init.threads = 1;
+      for (int c; (c = next++) < count; ) {
+        passes[c] = layoutPart(e, init, parts[c], g.n, layouts[c]);
+        stopped[c] = e.interrupted;
+        errors[c] = e.error;
+      }
+    });
+    this->iterations_run = *std::max_element(passes.begin(), passes.end());
+    this->interrupted = std::find(stopped.begin(), stopped.end(), 1) != stopped.end();
+    this->error = 0;
+    for (int c = 0; c < count && ! this->error; c++)
+      this->error = errors[c];
+
+    pack(count, g.n);
+    for (int c = 0; c < count; c++)
+      for (int i = 0; i < size(by_size[c]); i++)
+        pos[member[first[by_size[c]] + i]] = layouts[c][i];
+    normalizeToSpace(pos, space);
+  }
+
+  std::unique_ptr<ForceDirectedDrawing<T, Dim>> engine, initial;
+
+protected:
+  // kept between calls; the first `count' elements of the per-component
+  // vectors are in use
+  vector<int> comp, queue, first, fill, member, local, by_size, passes, errors, by_height;
+  vector<char> stopped;
+  vector<Graph<T>> parts;
+  vector<vector<Vector<T, Dim>>> layouts;
+  vector<Vector<T, Dim>> lo, hi;
+  // the control of the parts: ours without progress
+  LayoutControl<T, Dim> quiet;
+
+  // the component of the n vertices `members', renumbered by `local', into h
+  static void subgraph(const Graph<T>& g, const int* members, int n, const vector<int>& local, Graph<T>& h) {
+    h.n = n;
+    h.offset.resize(n + 1);
+    h.offset[0] = 0;
+    for (int i = 0; i < n; i++)
+      h.offset[i + 1] = h.offset[i] + g.degree(members[i]);
+    h.adj.resize(h.offset.back());
+    h.weight.resize(h.offset.back());
+    for (int i = 0; i < n; i++) {
+      int u = members[i];
+      for (int j = g.offset[u], k = h.offset[i]; j < g.offset[u + 1]; j++, k++) {
+        h.adj[k] = local[g.adj[j]];
+        h.weight[k] = g.weight[j];
+      }
+    }
+  }
+
+  // Lays out `part' from `init' in its share of the space of a graph of n
+  // vertices; returns the passes made
+  int layoutPart(ForceDirectedDrawing<T, Dim>& e, ForceDirectedDrawing<T, Dim>& init, const Graph<T>& part, int n, vector<Vector<T, Dim>>& layout) const {
+    layout.assign(part.n, Vector<T, Dim>());
+    for (auto& x : layout)
+      x.fill(T(0));
+    if (part.n == 1)
+      return 0;
+    T share = std::pow(T(part.n) / n, T(1) / T(Dim));
+    for (size_t dim = 0; dim < Dim; dim++)
+      e.space[dim] = space[dim] * share;
+    init.space = e.space;
+    init(part, layout);
+    e(part, layout);
+    return e.iterations_run;
+  }
+
+  // Shelf packing of the bounding boxes in the first two coordinates, with a
+  // gap of one vertex's share of the space between boxes. Boxes go by
+  // decreasing height into rows about as wide as the total area makes a box
+  // of the proportions of the space; within a row, boxes stack in columns
+  // while they fit under its first one.
+  void pack(int count, int n) {
+    T gap = 0;
+    for (size_t dim = 0; dim < Dim; dim++)
+      gap = max(gap, space[dim] * std::pow(T(1) / n, T(1) / T(Dim)));
+    lo.resize(count);
+    hi.resize(count);
+    T area = 0, widest = 0;
+    for (int c = 0; c < count; c++) {
+      lo[c].fill(numeric_limits<T>::max());
+      hi[c].fill(numeric_limits<T>::lowest());
+      for (auto& x : layouts[c])
+        for (size_t dim = 0; dim < Dim; dim++) {
+          lo[c][dim] = min(lo[c][dim], x[dim]);
+          hi[c][dim] = max(hi[c][dim], x[dim]);
+        }
+      area += (hi[c][0] - lo[c][0] + gap) * (hi[c][1] - lo[c][1] + gap);
+      widest = max(widest, hi[c][0] - lo[c][0] + gap);
+    }
+    T width = max(widest, sqrt(area * space[0] / space[1]));
+
+    by_height.resize(count);
+    for (int c = 0; c < count; c++)
+      by_height[c] = c;
+    std::sort(by_height.begin(), by_height.end(), [&](int a, int b) {
+      T ha = hi[a][1] - lo[a][1], hb = hi[b][1] - lo[b][1];
+      return ha != hb ? ha > hb : a < b;
+    });
+    // row at height y of height `row'; column at x of width `col', filled to `used'
+    T y = 0, row = 0, x = 0, col = 0, used = 0;
+    bool first = true;
+    for (int c : by_height) {
+      T w = hi[c][0] - lo[c][0] + gap, h = hi[c][1] - lo[c][1] + gap;
+      if (! first && used + h <= row && x + w <= width) {
+        col = max(col, w);
+      } else if (! first && x + col + w <= width) {
+        x += col;
+        col = w;
+        used = 0;
+      } else {
+        y += row;
+        row = h;
+        x = 0;
+        col = w;
+        used = 0;
+      }
+      first = false;
+      Vector<T, Dim> shift = - lo[c];
+      shift[0] += x;
+      shift[1] += y + used;
+      for (auto& p : layouts[c])
+        p += shift;
+      used += h;
+    }
+  }
+};
+
+#endif /* end of include guard: COMPONENTS_HH */
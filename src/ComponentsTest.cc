@@ -0,0 +1,50 @@
+// A workspace that packs components lays out a graph the same way cold,
+// whatever warm layouts it made before.
+#include <stdio.h>
+#include <vector>
+#include "ForceDirected.hh"
+
+using std::vector;
+
+// cycles of 24, 12 and 6 vertices and one alone
+static void graph(int& n, vector<int>& u, vector<int>& v)
+{
+  n = 0;
+  for (int len : {24, 12, 6}) {
+    for (int i = 0; i < len; i++) {
+      u.push_back(n + i);
+      v.push_back(n + (i + 1) % len);
+    }
+    n += len;
+  }
+  n++;
+}
+
+static bool coldAfterWarm(LayoutAlgorithm algorithm, const char* name)
+{
+  int n;
+  vector<int> u, v;
+  graph(n, u, v);
+  LayoutOptions o;
+  o.algorithm = algorithm;
+  LayoutWorkspace ws(o);
+  vector<double> first(2 * n), warm, second(2 * n);
+  if (ws.layout(n, u.size(), u.data(), v.data(), NULL, first.data()) < 0)
+    return false;
+  warm = first;
+  if (ws.layout(n, u.size(), u.data(), v.data(), NULL, warm.data(), true) < 0
+      || ws.layout(n, u.size(), u.data(), v.data(), NULL, second.data()) < 0)
+    return false;
+  if (first != second) {
+    fprintf(stderr, "%s: a cold layout after a warm one differs from the first\n", name);
+    return false;
+  }
+  return true;
+}
+
+int main()
+{
+  bool ok = coldAfterWarm(LAYOUT_FRUCHTERMAN_REINGOLD, "Fruchterman-Reingold");
+  ok &= coldAfterWarm(LAYOUT_KAMADA_KAWAI, "Kamada-Kawai");
+  return ok ? 0 : 1;
+}
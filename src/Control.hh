@@ -0,0 +1,37 @@
+#ifndef CONTROL_HH
+#define CONTROL_HH
+
+#include <atomic>
+#include <chrono>
+#include "Core.hh"
+
+// What a layout in progress shows its observer: positions as the engine
+// holds them, not yet fitted to the space, where pos[i] is that of vertex
+// (*label)[i], or of vertex i without labels. Valid during the call only.
+template<typename T, size_t Dim>
+struct LayoutProgress
+{
+  const vector<Vector<T, Dim>>& pos;
+  const vector<int>* label;
+  // passes (pivots for Kamada-Kawai) made so far
+  int pass;
+};
+
+// Run-time control of a layout. Engines check it after every pass and stop
+// with the positions reached once `deadline' has passed or `*cancel' is
+// set, which another thread may do at any time; every `interval' passes they
+// show `progress' the positions, which stops the layout by returning false.
+// Engines only point to it, and check it out of line (Core.cc), so that none
+// of this is compiled into their passes.
+template<typename T, size_t Dim>
+struct LayoutControl
+{
+  typedef std::chrono::steady_clock Clock;
+  LayoutControl() : deadline(Clock::time_point::max()), cancel(NULL), interval(1) {}
+  Clock::time_point deadline;
+  const std::atomic<bool>* cancel;
+  function<bool(const LayoutProgress<T, Dim>&)> progress;
+  int interval;
+};
+
+#endif /* end of include guard: CONTROL_HH */
@@ -0,0 +1,69 @@
+#ifndef COOLING_HH
+#define COOLING_HH
+
+#include "Core.hh"
+
+enum CoolingSchedule { COOLING_LINEAR, COOLING_ADAPTIVE };
+
+// Step length of a spring-electrical layout from pass to pass, and when to
+// stop. Linear cooling falls from the start temperature to zero over the
+// passes. Adaptive cooling (Hu, "Efficient and high quality force-directed
+// graph drawing") shrinks the step by `ratio' whenever the energy rises and
+// grows it again after `progress_passes' passes of steady decrease.
+// Either way the layout stops after `iterations' passes, or earlier once the
+// mean displacement of a pass is below tolerance * k or the energy has
+// changed by less than a fraction `tolerance' for progress_passes passes.
+template<typename T>
+struct Cooling
+{
+  Cooling()
+    : schedule(COOLING_LINEAR)
+      , tolerance(0)
+      , ratio(0.9)
+      , progress_passes(5) {}
+  // adaptive steps start from at most the edge length `k', as in Hu
+  void start(T temperature, int iterations, T k) {
+    this->temperature = temperature;
+    step = min(temperature, k);
+    this->iterations = iterations;
+    this->k = k;
+    pass = progress = calm = 0;
+    energy = numeric_limits<T>::max();
+  }
+  // step length of the current pass
+  T current() const {
+    return schedule == COOLING_LINEAR ? temperature * (iterations - pass) / iterations : step;
+  }
+  bool first() const { return pass == 0; }
+  // Record the pass just made: summed displacement and energy (sum of
+  // squared forces) over n vertices. False when the layout should stop.
+  bool next(T displacement, T e, int n) {
+    pass++;
+    calm = std::abs(e - energy) < tolerance * energy ? calm + 1 : 0;
+    bool settled = n > 0 && (displacement < tolerance * k * n || calm >= progress_passes);
+    if (schedule == COOLING_ADAPTIVE) {
+      if (e < energy) {
+        if (++progress >= progress_passes) {
+          progress = 0;
+          step /= ratio;
+        }
+      } else {
+        progress = 0;
+        step *= ratio;
+      }
+    }
+    energy = e;
+    return pass < iterations && ! settled;
+  }
+  // passes made since start()
+  int passes() const { return pass; }
+
+  CoolingSchedule schedule;
+  T tolerance, ratio;
+  int progress_passes;
+protected:
+  T temperature, step, k, energy;
+  int iterations, pass, progress, calm;
+};
+
+#endif /* end of include guard: COOLING_HH */
@@ -1 +1,26 @@
+#include "Control.hh"
 
+template<typename T, size_t Dim>
+bool ForceDirectedDrawing<T, Dim>::expired()
+{
+  typedef typename LayoutControl<T, Dim>::Clock Clock;
+  if (! interrupted && control)
+    interrupted = (control->cancel && control->cancel->load(std::memory_order_relaxed))
+      || (control->deadline != Clock::time_point::max() && Clock::now() >= control->deadline);
+  return interrupted;
+}
+
+template<typename T, size_t Dim>
+bool ForceDirectedDrawing<T, Dim>::proceed(const vector<Vector<T, Dim>>& pos, int pass, const vector<int>* label, bool report)
+{
+  if (report && control && control->progress && control->interval > 0 && pass % control->interval == 0
+      && ! control->progress(LayoutProgress<T, Dim>{pos, label, pass}))
+    interrupted = true;
+  return ! expired();
+}
+
+// every precision and dimension force lays out in
+template struct ForceDirectedDrawing<float, 2>;
+template struct ForceDirectedDrawing<float, 3>;
+template struct ForceDirectedDrawing<double, 2>;
+template struct ForceDirectedDrawing<double, 3>;
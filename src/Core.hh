@@ -4,10 +4,13 @@
 #include <algorithm>
 #include <array>
 #include <cmath>
+#include <cstdio>
 #include <limits>
 #include <functional>
+#include <numeric>
 #include <utility>
 #include <vector>
+#include "Stats.hh"
 using std::array;
 using std::bind;
 using std::function;
@@ -27,7 +30,9 @@ struct Vector : array<T, Dim>
     return s;
   }
   T dist(const Vector& r) const { return (*this - r).norm(); }
-  Vector unit() const { return (*this) / norm(); }
+  // unit(), norm() and norm2() are always inlined, as the repulsion tree
+  // walks call them for every pair they sum
+  __attribute__((always_inline)) Vector unit() const { return (*this) / norm(); }
   bool operator==(const Vector& r) const {
     for (int i = 0; i < Dim; i++) if ((*this)[i] != r[i]) return false;
     return true;
@@ -68,8 +73,8 @@ struct Vector : array<T, Dim>
     for (int i = 0; i < Dim; i++) (*this)[i] -= r[i];
     return *this;
   }
-  T norm() const { return sqrt(norm2()); }
-  T norm2() const {
+  __attribute__((always_inline)) T norm() const { return sqrt(norm2()); }
+  __attribute__((always_inline)) T norm2() const {
     T s(0);
     for (int i = 0; i < Dim; i++) s += (*this)[i] * (*this)[i];
     return s;
@@ -80,41 +85,108 @@ template<typename T, size_t Dim>
 Vector<T, Dim> operator*(T l, const Vector<T, Dim>& r)
 { return r * l; }
 
+// Compressed sparse row adjacency: the arcs leaving u are
+// adj[offset[u]..offset[u+1]) with weights weight[offset[u]..offset[u+1]).
+// Every undirected edge is stored as two arcs.
 template<typename T>
 class Graph
 {
 public:
-  Graph(int n) : n(n), e(n) {}
-  void addEdge(int u, int v, const T& w) {
-    e[u].push_back(std::make_pair(v, w));
-    e[v].push_back(std::make_pair(u, w));
+  struct Edge { int u, v; T w; };
+
+  Graph(int n) : n(n), offset(n + 1, 0) {}
+  template<typename It>
+  Graph(int n, It first, It last) { assign(n, first, last); }
+  // Counting sort of undirected edges; [first, last) is traversed twice.
+  // Reuses the storage of the previous graph.
+  template<typename It>
+  void assign(int n, It first, It last) {
+    this->n = n;
+    offset.assign(n + 1, 0);
+    for (It i = first; i != last; ++i) {
+      offset[i->u + 1]++;
+      offset[i->v + 1]++;
+    }
+    for (int u = 0; u < n; u++)
+      offset[u + 1] += offset[u];
+    adj.resize(offset[n]);
+    weight.resize(offset[n]);
+    // offset[u] serves as the fill pointer of u, which leaves it at the
+    // start of u + 1
+    for (It i = first; i != last; ++i) {
+      int j = offset[i->u]++;
+      adj[j] = i->v;
+      weight[j] = i->w;
+      j = offset[i->v]++;
+      adj[j] = i->u;
+      weight[j] = i->w;
+    }
+    for (int u = n; u > 0; u--)
+      offset[u] = offset[u - 1];
+    offset[0] = 0;
   }
-  typedef typename vector<pair<int, T> >::const_iterator It;
+  int degree(int u) const { return offset[u + 1] - offset[u]; }
   int n;
-  vector<vector<pair<int, T>>> e;
+  vector<int> offset, adj;
+  vector<T> weight;
 };
 
+// see Control.hh
+template<typename T, size_t Dim> struct LayoutControl;
+
 template<typename T, size_t Dim>
 struct ForceDirectedDrawing
 {
-  ForceDirectedDrawing(const array<T, Dim>& space) : space(space) {}
+  ForceDirectedDrawing(const array<T, Dim>& space) : space(space), threads(1), iterations_run(0), warm(false), control(NULL), interrupted(false), error(0) {}
   virtual ~ForceDirectedDrawing() {}
   virtual void operator()(const Graph<T>&, vector<Vector<T, Dim>>&) = 0;
+  // a new engine with the same settings, e.g. one per worker thread
+  virtual ForceDirectedDrawing* clone() const = 0;
+  // how far vertex u may move relative to a free one in a warm start: 0
+  // freezes it
+  T mobility(int u) const { return warm && ! mobilities.empty() ? mobilities[u] : T(1); }
   array<T, Dim> space;
+  int threads;
+  // passes made by the last call
+  int iterations_run;
+  // The positions passed in are already a layout to refine: start cool and
+  // keep their coordinates rather than normalizing to the space
+  bool warm;
+  // per vertex of the graph, see mobility(); empty lets every vertex move
+  // freely
+  vector<T> mobilities;
+  // checked after every pass; NULL for none
+  const LayoutControl<T, Dim>* control;
+  // the last call stopped early by `control'
+  bool interrupted;
+  // errno of what kept the last call from laying out the graph at all, such
+  // as a distance file that cannot be mapped; 0 if it did
+  int error;
+
+protected:
+  // Whether the deadline has passed or the layout is cancelled. Defined in
+  // Core.cc, so that the engines' passes are compiled without any of it.
+  bool expired();
+  // After pass `pass' reaching `pos' (see LayoutProgress); false when the
+  // layout should stop. Layouts of a graph other than the caller's, such as
+  // a coarse level, pass report = false.
+  bool proceed(const vector<Vector<T, Dim>>& pos, int pass, const vector<int>* label = NULL, bool report = true);
 };
 
 template<typename T, size_t Dim, typename G>
 void normalizeToSpace(vector<Vector<T, Dim>>& pos, const G& space)
 {
+  STATS_PHASE(PHASE_NORMALIZATION);
   for (size_t dim = 0; dim < Dim; dim++) {
     T minx = numeric_limits<T>::max(),
-      maxx = numeric_limits<T>::min();
+      maxx = numeric_limits<T>::lowest();
     for (auto &i : pos) {
       minx = min(minx, i[dim]);
       maxx = max(maxx, i[dim]);
     }
+    // a layout flat in this coordinate goes to the middle
     for (auto &i : pos)
-      i[dim] = (i[dim] - minx) / (maxx - minx) * space[dim];
+      i[dim] = maxx > minx ? (i[dim] - minx) / (maxx - minx) * space[dim] : space[dim] / 2;
   }
 }
 
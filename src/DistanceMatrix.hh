@@ -0,0 +1,85 @@
+#ifndef DISTANCEMATRIX_HH
+#define DISTANCEMATRIX_HH
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "Core.hh"
+
+// Symmetric distance matrix with a zero diagonal, stored as its strict upper
+// triangle in one row-major buffer of S. Entries are read and written as T;
+// an S of 16-bit integers holds multiples of `unit' (hop counts) below its
+// maximum, which callers must ensure. Unreachable pairs read as
+// numeric_limits<T>::max().
+//
+// With a path the buffer is a shared mapping of that file, so the matrix can
+// be larger than memory and is paged by the kernel. Otherwise its memory is
+// kept for the next resize(). A copy is an empty matrix, as matrices are the
+// scratch of the engine that fills them.
+template<typename T, typename S>
+class DistanceMatrix
+{
+public:
+  DistanceMatrix() : n(0), unit(1), data(NULL), mapped(0) {}
+  DistanceMatrix(const DistanceMatrix&) : DistanceMatrix() {}
+  DistanceMatrix& operator=(const DistanceMatrix&) = delete;
+  ~DistanceMatrix() { release(); }
+  // false if the file cannot be mapped
+  bool resize(int n, const char* path = NULL) {
+    release();
+    this->n = n;
+    size_t len = size_t(n) * (n - 1) / 2;
+    if (! path) {
+      buf.assign(len, infinity());
+      data = buf.data();
+      return true;
+    }
+    vector<S>().swap(buf);
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+      return false;
+    mapped = len * sizeof(S);
+    void* p = MAP_FAILED;
+    if (mapped == 0 || ftruncate(fd, mapped) == 0)
+      p = mmap(NULL, mapped ? mapped : 1, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+      mapped = 0;
+      return false;
+    }
+    data = static_cast<S*>(p);
+    std::fill(data, data + len, infinity());
+    return true;
+  }
+  // first entry of row u, whose columns are u+1..n-1
+  size_t row(int u) const { return size_t(u) * (2 * size_t(n) - u - 1) / 2 - u - 1; }
+  T get(int u, int v) const {
+    if (u == v) return T(0);
+    if (u > v) std::swap(u, v);
+    S s = data[row(u) + v];
+    return s == infinity() ? numeric_limits<T>::max() : T(s) * unit;
+  }
+  void set(int u, int v, T d) {
+    if (u > v) std::swap(u, v);
+    data[row(u) + v] = d == numeric_limits<T>::max() ? infinity() : S(d / unit + rounding());
+  }
+
+  int n;
+  T unit;
+protected:
+  static S infinity() { return numeric_limits<S>::is_integer ? numeric_limits<S>::max() : numeric_limits<S>::infinity(); }
+  static T rounding() { return numeric_limits<S>::is_integer ? T(0.5) : T(0); }
+  void release() {
+    if (mapped)
+      munmap(data, mapped);
+    mapped = 0;
+    data = NULL;
+  }
+
+  vector<S> buf;
+  S* data;
+  size_t mapped;
+};
+
+#endif /* end of include guard: DISTANCEMATRIX_HH */
@@ -0,0 +1,317 @@
+#ifndef EMBEDDING_HH
+#define EMBEDDING_HH
+
+#include <cmath>
+#include "Core.hh"
+#include "Components.hh"
+#include "Parallel.hh"
+#include "ShortestPath.hh"
+
+// Initial layouts that already show the global shape of the graph, for the
+// force-directed engines to refine instead of untangling a circle. Both cost
+// O(k m + k^2 n) for k pivots or Lanczos steps (k per coordinate for the
+// spectral layout) and are fitted to the space.
+
+// Eigenvalues of the symmetric k x k matrix a (row major, destroyed) in
+// decreasing order, by cyclic Jacobi rotations; vectors[i * k + j] is entry j
+// of the eigenvector of values[i]
+template<typename T>
+void symmetricEigen(vector<T>& a, int k, vector<T>& values, vector<T>& vectors)
+{
+  // the rotations accumulate in v, eigenvectors in columns
+  vector<T>& v = vectors;
+  v.assign(size_t(k) * k, T(0));
+  for (int i = 0; i < k; i++)
+    v[i * k + i] = 1;
+  T total(0);
+  for (T x : a)
+    total += x * x;
+  for (int sweep = 0; sweep < 50; sweep++) {
+    T off(0);
+    for (int p = 0; p < k; p++)
+      for (int q = p + 1; q < k; q++)
+        off += a[p * k + q] * a[p * k + q];
+    if (off <= total * numeric_limits<T>::epsilon() * numeric_limits<T>::epsilon())
+      break;
+    for (int p = 0; p < k; p++)
+      for (int q = p + 1; q < k; q++) {
+        if (a[p * k + q] == 0) continue;
+        T theta = (a[q * k + q] - a[p * k + p]) / (2 * a[p * k + q]);
+        T t = (theta >= 0 ? T(1) : T(-1)) / (std::abs(theta) + std::hypot(theta, T(1)));
+        T c = 1 / std::hypot(t, T(1)), s = t * c;
+        for (int r = 0; r < k; r++) {
+          T x = a[r * k + p], y = a[r * k + q];
+          a[r * k + p] = c * x - s * y;
+          a[r * k + q] = s * x + c * y;
+        }
+        for (int r = 0; r < k; r++) {
+          T x = a[p * k + r], y = a[q * k + r];
+          a[p * k + r] = c * x - s * y;
+          a[q * k + r] = s * x + c * y;
+        }
+        for (int r = 0; r < k; r++) {
+          T x = v[r * k + p], y = v[r * k + q];
+          v[r * k + p] = c * x - s * y;
+          v[r * k + q] = s * x + c * y;
+        }
+      }
+  }
+  // stable insertion sort of the columns by decreasing eigenvalue, then
+  // the columns become rows
+  values.resize(k);
+  for (int i = 0; i < k; i++)
+    values[i] = a[i * k + i];
+  for (int i = 1; i < k; i++)
+    for (int j = i; j > 0 && values[j - 1] < values[j]; j--) {
+      std::swap(values[j - 1], values[j]);
+      for (int r = 0; r < k; r++)
+        std::swap(v[r * k + j - 1], v[r * k + j]);
+    }
+  for (int i = 0; i < k; i++)
+    for (int j = i + 1; j < k; j++)
+      std::swap(v[i * k + j], v[j * k + i]);
+}
+
+// Fits an embedding to the space, then moves every vertex by a twentieth of
+// its share of the space in a direction of its own, as vertices with the
+// same embedding (leaves of one parent) would otherwise coincide
+template<typename T, size_t Dim>
+void spreadEmbedding(vector<Vector<T, Dim>>& pos, const array<T, Dim>& space)
+{
+  normalizeToSpace(pos, space);
+  int n = pos.size();
+  T nudge = *std::min_element(space.begin(), space.end()) / std::pow(T(max(n, 1)), T(1) / T(Dim)) / 20;
+  for (int u = 0; u < n; u++)
+    for (size_t dim = 0; dim < Dim; dim++)
+      pos[u][dim] += nudge * std::cos(T(2.39996) * u + T(1.5708) * dim);
+}
+
+// Harel and Koren, high-dimensional embedding: the graph distances to k
+// max-min pivots are coordinates in k dimensions, projected onto their Dim
+// principal components
+template<typename T, size_t Dim>
+struct HighDimensionalEmbedding : ForceDirectedDrawing<T, Dim>
+{
+  using ForceDirectedDrawing<T, Dim>::space;
+  using ForceDirectedDrawing<T, Dim>::threads;
+
+  HighDimensionalEmbedding(const array<T, Dim>& space)
+    : ForceDirectedDrawing<T, Dim>(space)
+      , pivots(50) {}
+  virtual HighDimensionalEmbedding* clone() const { return new HighDimensionalEmbedding(*this); }
+  virtual void operator()(const Graph<T>& g, vector<Vector<T, Dim>>& pos) {
+    int n = g.n;
+    if (n == 0) return;
+    int k = min(n, max(pivots, int(Dim)));
+    {
+      STATS_PHASE(PHASE_APSP);
+      maxMinPivots(g, k, piv, x, search);
+    }
+    STATS_PHASE(PHASE_INIT);
+    // unreachable vertices are as far as the farthest reachable one
+    T far(0);
+    for (T d : x)
+      if (d != numeric_limits<T>::max())
+        far = max(far, d);
+    parallelFor(threads, k, [&](int p) {
+      T* c = &x[size_t(p) * n];
+      T mean(0);
+      for (int v = 0; v < n; v++) {
+        if (c[v] == numeric_limits<T>::max())
+          c[v] = far;
+        mean += c[v] / n;
+      }
+      for (int v = 0; v < n; v++)
+        c[v] -= mean;
+    }, 1);
+
+    cov.resize(size_t(k) * k);
+    parallelFor(threads, k, [&](int p) {
+      for (int q = 0; q < k; q++) {
+        T s(0);
+        for (int v = 0; v < n; v++)
+          s += x[size_t(p) * n + v] * x[size_t(q) * n + v];
+        cov[p * k + q] = s;
+      }
+    }, 1);
+    symmetricEigen(cov, k, values, vectors);
+    parallelFor(threads, n, [&](int v) {
+      for (size_t dim = 0; dim < Dim; dim++) {
+        T s(0);
+        for (int p = 0; p < k; p++)
+          s += x[size_t(p) * n + v] * vectors[dim * k + p];
+        pos[v][dim] = s;
+      }
+    });
+    spreadEmbedding(pos, space);
+  }
+
+  int pivots;
+
+protected:
+  // kept between calls
+  vector<int> piv;
+  vector<T> x; // x[size_t(p) * n + v]: distance from the p-th pivot to v
+  vector<T> cov, values, vectors;
+  SearchBuffers<T> search;
+};
+
+// Koren, spectral drawing: the Dim eigenvectors of D^-1 A with the largest
+// eigenvalues below the trivial one, i.e. the smoothest degree-normalized
+// layout, by Lanczos on (I + D^-1/2 A D^-1/2) / 2 with full
+// reorthogonalization. One run of `steps' steps finds each coordinate,
+// deflated by the trivial eigenvector of every connected component and the
+// coordinates before it, so that eigenvalues of multiplicity above one (a
+// square grid) give all their eigenvectors. Edges count as one whatever their
+// weight.
+template<typename T, size_t Dim>
+struct Spectral : ForceDirectedDrawing<T, Dim>
+{
+  using ForceDirectedDrawing<T, Dim>::space;
+  using ForceDirectedDrawing<T, Dim>::threads;
+
+  Spectral(const array<T, Dim>& space)
+    : ForceDirectedDrawing<T, Dim>(space)
+      , steps(50) {}
+  virtual Spectral* clone() const { return new Spectral(*this); }
+  virtual void operator()(const Graph<T>& g, vector<Vector<T, Dim>>& pos) {
+    int n = g.n;
+    if (n == 0) return;
+    // Each run starts from the distances to a peripheral vertex, which vary
+    // slowly over the graph like the eigenvectors sought
+    {
+      STATS_PHASE(PHASE_APSP);
+      maxMinPivots(g, min(n, int(Dim) + 1), piv, pd, search);
+    }
+    STATS_PHASE(PHASE_INIT);
+    int count = connectedComponents(g, comp, search.queue);
+    root.resize(n);
+    scale.assign(count, T(0));
+    for (int u = 0; u < n; u++) {
+      int d = 0;
+      for (int j = g.offset[u]; j < g.offset[u + 1]; j++)
+        d += g.adj[j] != u;
+      root[u] = sqrt(T(max(d, 1)));
+      scale[comp[u]] += root[u] * root[u];
+    }
+    for (T& s : scale)
+      s = 1 / sqrt(s);
+
+    found.resize(Dim);
+    w.resize(n);
+    for (size_t dim = 0; dim < Dim; dim++) {
+      // with a little noise so that no eigenvector is missing from it
+      int p = min(int(dim) + 1, int(piv.size()) - 1);
+      for (int u = 0; u < n; u++) {
+        T d = pd[size_t(p) * n + u];
+        w[u] = ((d != numeric_limits<T>::max() ? d : T(0)) + T(hash(u + dim * n) % 1024) / 4096) * root[u];
+      }
+      lanczos(g, w, dim, found[dim]);
+      for (int u = 0; u < n; u++)
+        pos[u][dim] = found[dim][u] / root[u];
+    }
+    spreadEmbedding(pos, space);
+  }
+
+  int steps;
+
+protected:
+  // comp[u]: component of u; root[u]: sqrt(degree); the trivial eigenvector
+  // of a component is root on it times scale[component]
+  vector<int> comp;
+  vector<T> root, scale, q;
+  // eigenvectors of unit length, the first `known' found so far
+  vector<vector<T>> found;
+  // the rest is scratch kept between calls
+  vector<int> piv;
+  vector<T> pd, w, dots, c, alpha, beta, t, values, vectors;
+  SearchBuffers<T> search;
+
+  // Removes from w its components along the trivial eigenvectors, the first
+  // `known' of found and the first j Lanczos vectors, twice for accuracy
+  void deflate(vector<T>& w, int j, size_t known) {
+    int n = w.size();
+    dots.resize(scale.size());
+    c.resize(j + known);
+    for (int pass = 0; pass < 2; pass++) {
+      std::fill(dots.begin(), dots.end(), T(0));
+      for (int u = 0; u < n; u++)
+        dots[comp[u]] += w[u] * root[u] * scale[comp[u]];
+      parallelFor(threads, c.size(), [&](int i) {
+        const T* b = i < j ? &q[size_t(i) * n] : found[i - j].data();
+        T d(0);
+        for (int u = 0; u < n; u++)
+          d += b[u] * w[u];
+        c[i] = d;
+      }, 1);
+      parallelFor(threads, n, [&](int u) {
+        T d = dots[comp[u]] * root[u] * scale[comp[u]];
+        for (int i = 0; i < j; i++)
+          d += c[i] * q[size_t(i) * n + u];
+        for (size_t i = 0; i < known; i++)
+          d += c[j + i] * found[i][u];
+        w[u] -= d;
+      });
+    }
+  }
+
+  // Into y, the eigenvector with the largest eigenvalue within the span of
+  // the Krylov space from w, as deflated by the first `known' found
+  void lanczos(const Graph<T>& g, vector<T>& w, size_t known, vector<T>& y) {
+    int n = g.n;
+    q.resize(size_t(max(steps, 1)) * n);
+    alpha.clear();
+    beta.clear();
+    for (int j = 0; j < steps; j++) {
+      deflate(w, j, known);
+      T norm(0);
+      for (T x : w)
+        norm += x * x;
+      norm = sqrt(norm);
+      // the Krylov space is invariant: its Ritz vectors are exact
+      if (norm < T(1e-9)) break;
+      if (j)
+        beta.push_back(norm);
+      T* qj = &q[size_t(j) * n];
+      for (int u = 0; u < n; u++)
+        qj[u] = w[u] / norm;
+      // w = (I + D^-1/2 A D^-1/2) / 2 q_j
+      parallelFor(threads, n, [&](int u) {
+        T a(0);
+        for (int k = g.offset[u]; k < g.offset[u + 1]; k++)
+          if (g.adj[k] != u)
+            a += qj[g.adj[k]] / root[g.adj[k]];
+        w[u] = (qj[u] + a / root[u]) / 2;
+      });
+      T a(0);
+      for (int u = 0; u < n; u++)
+        a += w[u] * qj[u];
+      alpha.push_back(a);
+    }
+
+    int m = alpha.size();
+    t.assign(size_t(m) * m, T(0));
+    y.assign(n, T(0));
+    for (int i = 0; i < m; i++) {
+      t[i * m + i] = alpha[i];
+      if (i + 1 < m)
+        t[i * m + i + 1] = t[(i + 1) * m + i] = beta[i];
+    }
+    symmetricEigen(t, m, values, vectors);
+    if (m)
+      parallelFor(threads, n, [&](int u) {
+        for (int i = 0; i < m; i++)
+          y[u] += vectors[i] * q[size_t(i) * n + u];
+      });
+  }
+
+  static unsigned hash(unsigned u) {
+    u ^= u >> 16;
+    u *= 0x7feb352d;
+    u ^= u >> 15;
+    u *= 0x846ca68b;
+    return u ^ u >> 16;
+  }
+};
+
+#endif /* end of include guard: EMBEDDING_HH */
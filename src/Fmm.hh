@@ -0,0 +1,232 @@
+#ifndef FMM_HH
+#define FMM_HH
+
+#include <complex>
+#include "Core.hh"
+#include "Parallel.hh"
+
+// Fast multipole evaluation of the repulsion sum over v != u of
+// (x_u - x_v) / |x_u - x_v|^2 on every point, in O(n) for a fixed order.
+// Only the plane is supported; available tells whether Dim has an
+// implementation.
+template<typename T, size_t Dim>
+class Fmm
+{
+public:
+  static const bool available = false;
+  Fmm() : order(12), leaf_size(16), threads(1) {}
+  void evaluate(const vector<Vector<T, Dim>>&) {}
+  Vector<T, Dim> force(int) const {
+    Vector<T, Dim> res;
+    res.fill(0);
+    return res;
+  }
+  int order, leaf_size, threads;
+};
+
+// Greengard and Rokhlin on a uniform quadtree. With z the points as complex
+// numbers, the sum is conj(phi'(z_u)) for phi(z) = sum_v log(z - z_v).
+// Multipole expansions (P2M, M2M) go up, local expansions (M2L, L2L) come
+// down, and leaves add their neighbours directly.
+template<typename T>
+class Fmm<T, 2>
+{
+public:
+  static const bool available = true;
+  Fmm() : order(12), leaf_size(16), threads(1) {}
+  void evaluate(const vector<Vector<T, 2>>& pos) {
+    int n = pos.size();
+    f.resize(n);
+    if (n == 0) return;
+    int p = max(1, min(order, max_order));
+    binomials(2 * p);
+
+    // bounding square, split 2^levels times per side
+    T lo[2], size(0);
+    for (size_t dim = 0; dim < 2; dim++) {
+      T mn = pos[0][dim], mx = pos[0][dim];
+      for (auto& x : pos) {
+        mn = min(mn, x[dim]);
+        mx = max(mx, x[dim]);
+      }
+      lo[dim] = mn;
+      size = max(size, mx - mn);
+    }
+    size = size > 0 ? size * T(1.0001) : T(1);
+    origin = C(lo[0], lo[1]);
+    width = size;
+    levels = 2;
+    while (levels < 10 && n > leaf_size << (2 * levels))
+      levels++;
+    int side = 1 << levels;
+
+    // bucket the points by leaf
+    cell.resize(n);
+    start.assign(side * side + 1, 0);
+    for (int u = 0; u < n; u++) {
+      int ix = min(side - 1, int((pos[u][0] - lo[0]) / size * side)),
+          iy = min(side - 1, int((pos[u][1] - lo[1]) / size * side));
+      cell[u] = iy * side + ix;
+      start[cell[u] + 1]++;
+    }
+    for (int b = 0; b < side * side; b++)
+      start[b + 1] += start[b];
+    idx.resize(n);
+    z.resize(n);
+    fill.assign(start.begin(), start.end() - 1);
+    for (int u = 0; u < n; u++) {
+      int i = fill[cell[u]]++;
+      idx[i] = u;
+      z[i] = C(pos[u][0], pos[u][1]);
+    }
+
+    multipole.resize(levels + 1);
+    local.resize(levels + 1);
+    for (int l = 2; l <= levels; l++) {
+      multipole[l].resize((size_t(1) << (2 * l)) * (p + 1));
+      local[l].assign((size_t(1) << (2 * l)) * (p + 1), C(0));
+    }
+
+    // P2M
+    parallelFor(threads, side * side, [&](int b) {
+      C* a = &multipole[levels][size_t(b) * (p + 1)];
+      std::fill(a, a + p + 1, C(0));
+      C c = center(levels, b % side, b / side);
+      for (int i = start[b]; i < start[b + 1]; i++) {
+        C d = z[i] - c, dk = d;
+        a[0] += T(1);
+        for (int k = 1; k <= p; k++, dk *= d)
+          a[k] -= dk / T(k);
+      }
+    }, 16);
+
+    // M2M
+    for (int l = levels - 1; l >= 2; l--) {
+      int s = 1 << l;
+      parallelFor(threads, s * s, [&](int b) {
+        int ix = b % s, iy = b / s;
+        C* a = &multipole[l][size_t(b) * (p + 1)];
+        std::fill(a, a + p + 1, C(0));
+        C c = center(l, ix, iy);
+        for (int ch = 0; ch < 4; ch++) {
+          int cx = 2 * ix + (ch & 1), cy = 2 * iy + (ch >> 1);
+          const C* m = &multipole[l + 1][(size_t(cy) * 2 * s + cx) * (p + 1)];
+          if (m[0] == C(0)) continue;
+          C z0 = center(l + 1, cx, cy) - c;
+          C pw[max_order + 1];
+          pw[0] = C(1);
+          for (int k = 1; k <= p; k++)
+            pw[k] = pw[k - 1] * z0;
+          a[0] += m[0];
+          for (int j = 1; j <= p; j++) {
+            C sum = - m[0] * pw[j] / T(j);
+            for (int k = 1; k <= j; k++)
+              sum += m[k] * pw[j - k] * binom[j - 1][k - 1];
+            a[j] += sum;
+          }
+        }
+      }, 16);
+    }
+
+    // L2L and M2L over the interaction lists: children of the parent's
+    // neighbours that are not neighbours themselves
+    for (int l = 2; l <= levels; l++) {
+      int s = 1 << l;
+      parallelFor(threads, s * s, [&](int b) {
+        int ix = b % s, iy = b / s;
+        C* loc = &local[l][size_t(b) * (p + 1)];
+        C c = center(l, ix, iy);
+        if (l > 2) {
+          const C* up = &local[l - 1][(size_t(iy / 2) * (s / 2) + ix / 2) * (p + 1)];
+          C d = c - center(l - 1, ix / 2, iy / 2);
+          C pw[max_order + 1];
+          pw[0] = C(1);
+          for (int k = 1; k <= p; k++)
+            pw[k] = pw[k - 1] * d;
+          for (int m = 0; m <= p; m++)
+            for (int j = m; j <= p; j++)
+              loc[m] += up[j] * binom[j][m] * pw[j - m];
+        }
+        C inv[max_order + 1];
+        for (int py = iy / 2 - 1; py <= iy / 2 + 1; py++)
+          for (int px = ix / 2 - 1; px <= ix / 2 + 1; px++) {
+            if (px < 0 || py < 0 || px >= s / 2 || py >= s / 2) continue;
+            for (int ch = 0; ch < 4; ch++) {
+              int sx = 2 * px + (ch & 1), sy = 2 * py + (ch >> 1);
+              if (std::abs(sx - ix) <= 1 && std::abs(sy - iy) <= 1) continue;
+              const C* a = &multipole[l][(size_t(sy) * s + sx) * (p + 1)];
+              if (a[0] == C(0)) continue;
+              C z0 = center(l, sx, sy) - c, r = T(1) / z0;
+              // inv[k] = (-1)^k a_k / z0^k
+              C rk = C(1);
+              for (int k = 1; k <= p; k++) {
+                rk *= - r;
+                inv[k] = a[k] * rk;
+              }
+              C rl = C(1);
+              for (int j = 1; j <= p; j++) {
+                rl *= r;
+                C sum = - a[0] / T(j);
+                for (int k = 1; k <= p; k++)
+                  sum += inv[k] * binom[j + k - 1][k - 1];
+                loc[j] += sum * rl;
+              }
+            }
+          }
+      }, 16);
+    }
+
+    // local expansion plus the neighbouring leaves
+    parallelFor(threads, side * side, [&](int b) {
+      int ix = b % side, iy = b / side;
+      const C* loc = &local[levels][size_t(b) * (p + 1)];
+      C c = center(levels, ix, iy);
+      for (int i = start[b]; i < start[b + 1]; i++) {
+        C d = z[i] - c, phi(0);
+        for (int j = p; j >= 1; j--)
+          phi = phi * d + loc[j] * T(j);
+        for (int ny = max(0, iy - 1); ny <= min(side - 1, iy + 1); ny++)
+          for (int nx = max(0, ix - 1); nx <= min(side - 1, ix + 1); nx++) {
+            int nb = ny * side + nx;
+            for (int j = start[nb]; j < start[nb + 1]; j++)
+              if (z[j] != z[i])
+                phi += T(1) / (z[i] - z[j]);
+          }
+        f[idx[i]][0] = phi.real();
+        f[idx[i]][1] = - phi.imag();
+      }
+    }, 16);
+  }
+  Vector<T, 2> force(int u) const { return f[u]; }
+
+  // expansion order, at most max_order
+  int order, leaf_size, threads;
+  static const int max_order = 32;
+protected:
+  typedef std::complex<T> C;
+  C center(int l, int ix, int iy) const {
+    T w = width / T(1 << l);
+    return origin + C((ix + T(0.5)) * w, (iy + T(0.5)) * w);
+  }
+  void binomials(int m) {
+    if (int(binom.size()) > m) return;
+    binom.assign(m + 1, vector<T>(m + 1, T(0)));
+    for (int i = 0; i <= m; i++) {
+      binom[i][0] = 1;
+      for (int j = 1; j <= i; j++)
+        binom[i][j] = binom[i - 1][j - 1] + (j < i ? binom[i - 1][j] : T(0));
+    }
+  }
+
+  C origin;
+  T width;
+  int levels;
+  vector<int> start, idx; // points of leaf b are z[start[b]..start[b+1]), z[i] being pos[idx[i]]
+  vector<int> cell, fill; // leaf of each point, and bucketing scratch
+  vector<C> z;
+  vector<vector<C>> multipole, local; // per level, order + 1 coefficients per box
+  vector<vector<T>> binom;
+  vector<Vector<T, 2>> f;
+};
+
+#endif /* end of include guard: FMM_HH */
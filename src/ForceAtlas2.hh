@@ -0,0 +1,23 @@
+#ifndef FORCEATLAS2_HH
+#define FORCEATLAS2_HH
+
+#include "SpringElectrical.hh"
+
+// Jacomy et al., ForceAtlas2: attraction linear in the distance and
+// repulsion k^2 (degree + 1) / d, pushing hubs apart from everything. The
+// original weighs each pair by (deg_u + 1)(deg_v + 1); the repulsive field
+// sums unit charges, so only the degree of the vertex pushed is counted.
+struct ForceAtlas2Forces
+{
+  template<typename T>
+  T repulsion(T k, T c, int degree) const { return k * k * c * (degree + 1); }
+  template<typename T, size_t Dim>
+  Vector<T, Dim> attraction(const Vector<T, Dim>& dist, T, T c, int) const {
+    return dist * c;
+  }
+};
+
+template<typename T, size_t Dim>
+using ForceAtlas2 = SpringElectrical<T, Dim, ForceAtlas2Forces>;
+
+#endif /* end of include guard: FORCEATLAS2_HH */
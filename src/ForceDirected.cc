@@ -0,0 +1,306 @@
+#include <memory>
+#include "ForceDirected.hh"
+#include "forcedirected.h"
+#include "Core.hh"
+#include "Control.hh"
+#include "Circle.hh"
+#include "FruchtermanReingold.hh"
+#include "Walshaw.hh"
+#include "LinLog.hh"
+#include "ForceAtlas2.hh"
+#include "MultilevelWalshaw.hh"
+#include "KamadaKawai.hh"
+#include "StressMajorization.hh"
+#include "Components.hh"
+#include "Embedding.hh"
+#include "Input.hh"
+
+static bool validOptions(const LayoutOptions& o)
+{
+  return LAYOUT_FRUCHTERMAN_REINGOLD <= o.algorithm && o.algorithm <= LAYOUT_FORCE_ATLAS2
+    && LAYOUT_INIT_CIRCLE <= o.initial && o.initial <= LAYOUT_INIT_SPECTRAL
+    && (o.dim == 2 || o.dim == 3)
+    && o.iterations > 0 && o.threads > 0
+    // a space without room gives a spring length of 0, and NaN positions
+    && 0 < o.size[0] && 0 < o.size[1] && (o.dim == 2 || 0 < o.size[2]);
+}
+
+struct LayoutWorkspace::Impl
+{
+  Impl() : budget(0), interval(1), cancelled(false) {}
+  virtual ~Impl() {}
+  virtual int layout(int n, int m, const int* u, const int* v, const double* w, double* coords, bool warm) = 0;
+  virtual bool interrupted() const = 0;
+
+  double budget;
+  std::function<bool(const LayoutSnapshot&)> progress;
+  int interval;
+  std::atomic<bool> cancelled;
+};
+
+// force's settings for a spring-electrical engine
+template<typename E>
+static E* springElectrical(E* a, const LayoutOptions& o)
+{
+  a->iterations = o.iterations;
+  a->force_constant = 0.1;
+  return a;
+}
+
+template<typename T, size_t Dim>
+struct Workspace : LayoutWorkspace::Impl
+{
+  Workspace(const LayoutOptions& o)
+    : weighted(o.algorithm == LAYOUT_KAMADA_KAWAI || o.algorithm == LAYOUT_STRESS_MAJORIZATION)
+      , g(0) {
+    array<T, Dim> space;
+    for (size_t dim = 0; dim < Dim; dim++)
+      space[dim] = T(o.size[dim]);
+    switch (o.algorithm) {
+    case LAYOUT_WALSHAW:
+      algo.reset(springElectrical(new Walshaw<T, Dim>(space), o));
+      break;
+    case LAYOUT_KAMADA_KAWAI:
+      algo.reset(new KamadaKawai<T, Dim>(space));
+      break;
+    case LAYOUT_MULTILEVEL_WALSHAW:
+      algo.reset(springElectrical(new MultilevelWalshaw<T, Dim>(space), o));
+      break;
+    case LAYOUT_STRESS_MAJORIZATION:
+      {
+        auto a = new StressMajorization<T, Dim>(space);
+        a->iterations = o.iterations;
+        algo.reset(a);
+      }
+      break;
+    case LAYOUT_LINLOG:
+      algo.reset(springElectrical(new LinLog<T, Dim>(space), o));
+      break;
+    case LAYOUT_FORCE_ATLAS2:
+      algo.reset(springElectrical(new ForceAtlas2<T, Dim>(space), o));
+      break;
+    default:
+      algo.reset(springElectrical(new FruchtermanReingold<T, Dim>(space), o));
+    }
+    if (o.initial == LAYOUT_INIT_HDE)
+      initial.reset(new HighDimensionalEmbedding<T, Dim>(space));
+    else if (o.initial == LAYOUT_INIT_SPECTRAL)
+      initial.reset(new Spectral<T, Dim>(space));
+    else
+      initial.reset(new Circle<T, Dim>(space));
+    initial->threads = o.threads;
+    // packed components make their own start
+    if (o.pack_components)
+      algo.reset(new ComponentLayout<T, Dim>(algo.release(), initial.release()));
+    algo->threads = o.threads;
+    control.cancel = &cancelled;
+    algo->control = &control;
+  }
+
+  virtual int layout(int n, int m, const int* u, const int* v, const double* w, double* coords, bool warm) {
+    // a cancel() only stops the layout it came during
+    cancelled = false;
+    if (n < 0 || m < 0 || (m > 0 && ! (u && v)) || (n > 0 && ! coords))
+      return -1;
+    for (int i = 0; i < m; i++)
+      if (! (0 <= u[i] && u[i] < n && 0 <= v[i] && v[i] < n) || (w && ! (0 <= w[i])))
+        return -1;
+    if (n == 0)
+      return 0;
+    BinaryEdgeIterator<T> first, last;
+    first.u = u;
+    first.v = v;
+    first.w = weighted ? w : NULL;
+    first.i = 0;
+    last = first;
+    last.i = m;
+    g.assign(n, first, last);
+    pos.resize(n);
+    if (warm)
+      for (int i = 0; i < n; i++)
+        for (size_t dim = 0; dim < Dim; dim++)
+          pos[i][dim] = T(coords[i * Dim + dim]);
+
+    typedef typename LayoutControl<T, Dim>::Clock Clock;
+    control.deadline = budget > 0
+      ? Clock::now() + std::chrono::duration_cast<typename Clock::duration>(std::chrono::duration<double>(budget))
+      : Clock::time_point::max();
+    control.interval = interval;
+    // captures only this, so that copies of it need no memory
+    if (progress)
+      control.progress = [this](const LayoutProgress<T, Dim>& p) {
+        LayoutSnapshot s = {p.pos.empty() ? NULL : p.pos[0].data(), p.label ? p.label->data() : NULL, int(p.pos.size()), p.pass};
+        return progress(s);
+      };
+    else
+      control.progress = nullptr;
+    algo->warm = warm;
+    if (! warm && initial)
+      (*initial)(g, pos);
+    (*algo)(g, pos);
+    if (algo->error)
+      return -1;
+
+    for (int i = 0; i < n; i++)
+      for (size_t dim = 0; dim < Dim; dim++)
+        coords[i * Dim + dim] = pos[i][dim];
+    return algo->iterations_run;
+  }
+  virtual bool interrupted() const { return algo->interrupted; }
+
+  bool weighted;
+  // initial is NULL when algo makes its own start
+  std::unique_ptr<ForceDirectedDrawing<T, Dim>> algo, initial;
+  LayoutControl<T, Dim> control;
+  Graph<T> g;
+  vector<Vector<T, Dim>> pos;
+};
+
+LayoutWorkspace::LayoutWorkspace(const LayoutOptions& options)
+  : impl(NULL)
+{
+  if (! validOptions(options))
+    return;
+  if (options.dim == 3)
+    impl = options.single ? static_cast<Impl*>(new Workspace<float, 3>(options)) : new Workspace<double, 3>(options);
+  else
+    impl = options.single ? static_cast<Impl*>(new Workspace<float, 2>(options)) : new Workspace<double, 2>(options);
+}
+
+LayoutWorkspace::~LayoutWorkspace()
+{
+  delete impl;
+}
+
+int LayoutWorkspace::layout(int n, int m, const int* u, const int* v, const double* w, double* coords, bool warm)
+{
+  return impl ? impl->layout(n, m, u, v, w, coords, warm) : -1;
+}
+
+void LayoutWorkspace::setBudget(double seconds)
+{
+  if (impl)
+    impl->budget = seconds;
+}
+
+void LayoutWorkspace::cancel()
+{
+  if (impl)
+    impl->cancelled = true;
+}
+
+void LayoutWorkspace::setProgress(std::function<bool(const LayoutSnapshot&)> f, int interval)
+{
+  if (! impl)
+    return;
+  impl->progress = std::move(f);
+  impl->interval = interval;
+}
+
+bool LayoutWorkspace::interrupted() const
+{
+  return impl && impl->interrupted();
+}
+
+struct fd_workspace
+{
+  fd_workspace(const LayoutOptions& options) : ws(options) {}
+  LayoutWorkspace ws;
+};
+
+// No exception leaves the C calls: those that return a result fail as they
+// do for bad arguments, the others do nothing.
+
+void fd_options_init(fd_options* options)
+{
+  try {
+    LayoutOptions o;
+    options->algorithm = o.algorithm;
+    options->dim = o.dim;
+    options->single = o.single;
+    for (int dim = 0; dim < 3; dim++)
+      options->size[dim] = o.size[dim];
+    options->iterations = o.iterations;
+    options->threads = o.threads;
+    options->initial = o.initial;
+    options->pack_components = o.pack_components;
+  } catch (...) {
+  }
+}
+
+fd_workspace* fd_workspace_new(const fd_options* options)
+{
+  try {
+    LayoutOptions o;
+    o.algorithm = LayoutAlgorithm(options->algorithm);
+    o.dim = options->dim;
+    o.single = options->single != 0;
+    for (int dim = 0; dim < 3; dim++)
+      o.size[dim] = options->size[dim];
+    o.iterations = options->iterations;
+    o.threads = options->threads;
+    o.initial = LayoutInitial(options->initial);
+    o.pack_components = options->pack_components != 0;
+    return validOptions(o) ? new fd_workspace(o) : NULL;
+  } catch (...) {
+    return NULL;
+  }
+}
+
+void fd_workspace_free(fd_workspace* ws)
+{
+  try {
+    delete ws;
+  } catch (...) {
+  }
+}
+
+int fd_layout(fd_workspace* ws, int n, int m, const int* u, const int* v, const double* w, double* coords, int warm)
+{
+  try {
+    return ws->ws.layout(n, m, u, v, w, coords, warm != 0);
+  } catch (...) {
+    return -1;
+  }
+}
+
+void fd_set_budget(fd_workspace* ws, double seconds)
+{
+  try {
+    ws->ws.setBudget(seconds);
+  } catch (...) {
+  }
+}
+
+void fd_cancel(fd_workspace* ws)
+{
+  try {
+    ws->ws.cancel();
+  } catch (...) {
+  }
+}
+
+int fd_set_progress(fd_workspace* ws, fd_progress f, void* user, int interval)
+{
+  try {
+    if (f)
+      ws->ws.setProgress([f, user](const LayoutSnapshot& s) {
+        fd_snapshot c = {s.coords, s.label, s.n, s.pass};
+        return f(&c, user) != 0;
+      }, interval);
+    else
+      ws->ws.setProgress(nullptr, interval);
+  } catch (...) {
+    return -1;
+  }
+  return 0;
+}
+
+int fd_interrupted(const fd_workspace* ws)
+{
+  try {
+    return ws->ws.interrupted();
+  } catch (...) {
+    return 0;
+  }
+}
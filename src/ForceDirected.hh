@@ -0,0 +1,96 @@
+#ifndef FORCEDIRECTED_HH
+#define FORCEDIRECTED_HH
+
+#include <functional>
+
+// Graph layout for programs that link libforcedirected. Nothing here depends
+// on the engines' templates, so programs built against this header keep
+// working with later builds of the library.
+
+enum LayoutAlgorithm {
+  LAYOUT_FRUCHTERMAN_REINGOLD, LAYOUT_WALSHAW, LAYOUT_KAMADA_KAWAI, LAYOUT_MULTILEVEL_WALSHAW,
+  LAYOUT_STRESS_MAJORIZATION, LAYOUT_LINLOG, LAYOUT_FORCE_ATLAS2
+};
+enum LayoutInitial { LAYOUT_INIT_CIRCLE, LAYOUT_INIT_HDE, LAYOUT_INIT_SPECTRAL };
+
+// The settings of force's options of the same names; the defaults are
+// force's
+struct LayoutOptions
+{
+  LayoutOptions()
+    : algorithm(LAYOUT_FRUCHTERMAN_REINGOLD)
+      , dim(2)
+      , single(false)
+      , iterations(50)
+      , threads(1)
+      , initial(LAYOUT_INIT_CIRCLE)
+      , pack_components(true) {
+    size[0] = size[1] = size[2] = 400;
+  }
+  LayoutAlgorithm algorithm;
+  // coordinates per vertex, 2 or 3
+  int dim;
+  // float arithmetic (--precision float)
+  bool single;
+  // x, y and z of the space
+  double size[3];
+  // passes of the spring-electrical engines and of stress majorization;
+  // this, threads and the sizes used must be positive
+  int iterations;
+  int threads;
+  LayoutInitial initial;
+  // --components pack
+  bool pack_components;
+};
+
+// A layout in progress: coords holds n rows of dim floats (with single) or
+// doubles, as the engine holds them and not yet fitted to the space; row i
+// is vertex label[i], or vertex i if label is NULL. Valid during the call
+// only.
+struct LayoutSnapshot
+{
+  const void* coords;
+  const int* label;
+  int n, pass;
+};
+
+// One engine with its settings and everything a layout needs besides the
+// graph and the coordinates passed in, kept from call to call. Once a
+// workspace has laid out graphs as large as those to come, further layouts
+// with threads = 1 allocate no memory. A workspace is for one thread at a
+// time, except for cancel().
+class LayoutWorkspace
+{
+public:
+  explicit LayoutWorkspace(const LayoutOptions& options = LayoutOptions());
+  ~LayoutWorkspace();
+  LayoutWorkspace(const LayoutWorkspace&) = delete;
+  LayoutWorkspace& operator=(const LayoutWorkspace&) = delete;
+
+  // Lays out the graph of n vertices and the m edges (u[i], v[i]) into
+  // coords, dim per vertex. Edge i weighs w[i], or 1 if w is NULL; only
+  // Kamada-Kawai and stress majorization read weights. With `warm', coords
+  // already hold a layout to refine, which stays in its units. Returns the
+  // passes made, or -1 for invalid options, a malformed graph or a layout
+  // that failed, leaving coords as they were.
+  int layout(int n, int m, const int* u, const int* v, const double* w, double* coords, bool warm = false);
+
+  // Each layout stops `seconds' after it starts, with the positions
+  // reached; 0 lifts the limit
+  void setBudget(double seconds);
+  // Stops the layout in progress, from any thread; one made between layouts
+  // is dropped
+  void cancel();
+  // Calls f every `interval' passes of each layout; f returning false
+  // stops it. An empty f removes it.
+  void setProgress(std::function<bool(const LayoutSnapshot&)> f, int interval = 1);
+  // whether the budget, cancel() or the progress function stopped the last
+  // layout
+  bool interrupted() const;
+
+  struct Impl;
+private:
+  Impl* impl;
+};
+
+#endif /* end of include guard: FORCEDIRECTED_HH */
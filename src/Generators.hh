@@ -0,0 +1,148 @@
+#ifndef GENERATORS_HH
+#define GENERATORS_HH
+
+#include <random>
+#include <string.h>
+#include "Core.hh"
+
+// Synthetic graphs for benchmarks. Every generator takes the number of
+// vertices and a seed and returns an unweighted graph (all weights 1); the
+// same arguments always give the same graph.
+
+enum GraphFamily { GRAPH_GRID, GRAPH_RGG, GRAPH_BA, GRAPH_TREE, GRAPH_UNION };
+
+// a side x ceil(n / side) grid, rows cut short to n vertices
+template<typename T>
+Graph<T> gridGraph(int n, unsigned)
+{
+  int side = max(1, int(std::ceil(std::sqrt(double(n)))));
+  vector<typename Graph<T>::Edge> edges;
+  for (int u = 0; u < n; u++) {
+    if (u % side + 1 < side && u + 1 < n)
+      edges.push_back({u, u + 1, T(1)});
+    if (u + side < n)
+      edges.push_back({u, u + side, T(1)});
+  }
+  return Graph<T>(n, edges.begin(), edges.end());
+}
+
+// Random geometric graph: n uniform points in the unit square, linked when
+// closer than the radius that gives an expected degree of `degree'.
+// Neighbours are found through a grid of cells of that radius.
+template<typename T>
+Graph<T> geometricGraph(int n, unsigned seed, double degree = 8)
+{
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> uniform(0, 1);
+  vector<array<double, 2>> p(n);
+  for (auto& x : p)
+    x = {{uniform(rng), uniform(rng)}};
+  double r = std::sqrt(degree / (M_PI * max(n, 1)));
+  int side = max(1, min(int(1 / r), 1 << 12));
+  auto cell = [&](double x) { return min(side - 1, int(x * side)); };
+  vector<int> start(side * side + 1, 0), order(n);
+  for (auto& x : p)
+    start[cell(x[1]) * side + cell(x[0]) + 1]++;
+  for (int c = 0; c < side * side; c++)
+    start[c + 1] += start[c];
+  vector<int> fill(start.begin(), start.end() - 1);
+  for (int u = 0; u < n; u++)
+    order[fill[cell(p[u][1]) * side + cell(p[u][0])]++] = u;
+  vector<typename Graph<T>::Edge> edges;
+  for (int u = 0; u < n; u++) {
+    int cx = cell(p[u][0]), cy = cell(p[u][1]);
+    for (int y = max(0, cy - 1); y <= min(side - 1, cy + 1); y++)
+      for (int x = max(0, cx - 1); x <= min(side - 1, cx + 1); x++)
+        for (int j = start[y * side + x]; j < start[y * side + x + 1]; j++) {
+          int v = order[j];
+          double dx = p[u][0] - p[v][0], dy = p[u][1] - p[v][1];
+          if (u < v && dx * dx + dy * dy < r * r)
+            edges.push_back({u, v, T(1)});
+        }
+  }
+  return Graph<T>(n, edges.begin(), edges.end());
+}
+
+// Barabasi-Albert preferential attachment: each new vertex links to
+// `links' distinct earlier ones chosen proportionally to their degree
+template<typename T>
+Graph<T> barabasiAlbertGraph(int n, unsigned seed, int links = 2)
+{
+  std::mt19937 rng(seed);
+  vector<typename Graph<T>::Edge> edges;
+  vector<int> ends; // every edge contributes both endpoints
+  for (int u = 1; u < n; u++) {
+    int k = min(u, links);
+    vector<int> chosen;
+    while (int(chosen.size()) < k) {
+      int v = ends.empty() || u <= links ? int(rng() % u) : ends[rng() % ends.size()];
+      if (std::find(chosen.begin(), chosen.end(), v) == chosen.end())
+        chosen.push_back(v);
+    }
+    for (int v : chosen) {
+      edges.push_back({u, v, T(1)});
+      ends.push_back(u);
+      ends.push_back(v);
+    }
+  }
+  return Graph<T>(n, edges.begin(), edges.end());
+}
+
+// Random recursive tree: vertex u hangs from a uniform earlier vertex
+template<typename T>
+Graph<T> treeGraph(int n, unsigned seed)
+{
+  std::mt19937 rng(seed);
+  vector<typename Graph<T>::Edge> edges;
+  for (int u = 1; u < n; u++)
+    edges.push_back({u, int(rng() % u), T(1)});
+  return Graph<T>(n, edges.begin(), edges.end());
+}
+
+template<typename T>
+Graph<T> generateGraph(GraphFamily family, int n, unsigned seed);
+
+// Disjoint union of a grid, a geometric graph, a Barabasi-Albert graph and
+// a tree of about n / 4 vertices each
+template<typename T>
+Graph<T> unionGraph(int n, unsigned seed)
+{
+  vector<typename Graph<T>::Edge> edges;
+  int base = 0;
+  for (int part = 0; part < 4; part++) {
+    int size = n / 4 + (part < n % 4);
+    Graph<T> g = generateGraph<T>(GraphFamily(part), size, seed + part);
+    for (int u = 0; u < g.n; u++)
+      for (int j = g.offset[u]; j < g.offset[u + 1]; j++)
+        if (u < g.adj[j])
+          edges.push_back({base + u, base + g.adj[j], g.weight[j]});
+    base += size;
+  }
+  return Graph<T>(n, edges.begin(), edges.end());
+}
+
+template<typename T>
+Graph<T> generateGraph(GraphFamily family, int n, unsigned seed)
+{
+  switch (family) {
+  case GRAPH_GRID: return gridGraph<T>(n, seed);
+  case GRAPH_RGG: return geometricGraph<T>(n, seed);
+  case GRAPH_BA: return barabasiAlbertGraph<T>(n, seed);
+  case GRAPH_TREE: return treeGraph<T>(n, seed);
+  default: return unionGraph<T>(n, seed);
+  }
+}
+
+// "grid", "rgg", "ba", "tree" or "union"; false if unknown
+inline bool parseGraphFamily(const char* name, GraphFamily& family)
+{
+  static const char* names[] = {"grid", "rgg", "ba", "tree", "union"};
+  for (int i = 0; i < 5; i++)
+    if (! strcmp(name, names[i])) {
+      family = GraphFamily(i);
+      return true;
+    }
+  return false;
+}
+
+#endif /* end of include guard: GENERATORS_HH */
@@ -0,0 +1,119 @@
+#ifndef GRID_HH
+#define GRID_HH
+
+#include <vector>
+#include "Core.hh"
+#include "Parallel.hh"
+
+// Uniform cell list, as in the original Fruchterman-Reingold: points only
+// repel within `cutoff', so binning them into cells at least that wide and
+// looking at the 3^Dim cells around a point finds every interaction. Cells
+// are rebuilt from scratch by a counting sort on every build(). With roughly
+// uniform density the work is O(n) per iteration.
+template<typename T, size_t Dim>
+class CellGrid
+{
+public:
+  CellGrid() : threads(1) {}
+  void build(const vector<Vector<T, Dim>>& coords, T cutoff) {
+    int n = coords.size();
+    this->cutoff = cutoff;
+    start.assign(2, 0);
+    pts.clear();
+    if (n == 0) return;
+
+    // cells no smaller than the cutoff, and at most 4 per point in all:
+    // sizing them by the volume alone leaves a flat layout with far more
+    T volume(1);
+    for (size_t dim = 0; dim < Dim; dim++) {
+      lo[dim] = hi[dim] = coords[0][dim];
+      for (auto& x : coords) {
+        lo[dim] = min(lo[dim], x[dim]);
+        hi[dim] = max(hi[dim], x[dim]);
+      }
+      volume *= max(hi[dim] - lo[dim], T(0));
+    }
+    size_t most = 4 * size_t(n);
+    size = max(cutoff, std::pow(volume / T(most), T(1) / T(Dim)));
+    for (;;) {
+      double count = 1;
+      for (size_t dim = 0; dim < Dim; dim++)
+        count *= std::floor(double((hi[dim] - lo[dim]) / size)) + 1;
+      if (! (count > double(most)))
+        break;
+      size *= max(T(std::pow(count / double(most), 1.0 / Dim)), T(1.1));
+    }
+    size_t cells = 1;
+    for (size_t dim = 0; dim < Dim; dim++) {
+      T extent = (hi[dim] - lo[dim]) / size;
+      side[dim] = extent < T(most) ? int(extent) + 1 : 1;
+      cells *= side[dim];
+    }
+
+    cell.resize(n);
+    parallelFor(threads, n, [&](int u) { cell[u] = index(coords[u]); });
+    start.assign(cells + 1, 0);
+    for (int u = 0; u < n; u++)
+      start[cell[u] + 1]++;
+    for (size_t c = 0; c < cells; c++)
+      start[c + 1] += start[c];
+    fill.assign(start.begin(), start.end() - 1);
+    pts.resize(n);
+    for (int u = 0; u < n; u++)
+      pts[fill[cell[u]]++] = coords[u];
+  }
+  // sum over points p within the cutoff of (orig - p) / |orig - p|^2
+  Vector<T, Dim> getRepulsive(const Vector<T, Dim>& orig) const {
+    Vector<T, Dim> res;
+    res.fill(0);
+    if (pts.empty()) return res;
+    int c[Dim], from[Dim], to[Dim];
+    for (size_t dim = 0; dim < Dim; dim++) {
+      c[dim] = coordinate(orig, dim);
+      from[dim] = max(0, c[dim] - 1);
+      to[dim] = min(side[dim] - 1, c[dim] + 1);
+      c[dim] = from[dim];
+    }
+    T cutoff2 = cutoff == numeric_limits<T>::max() ? cutoff : cutoff * cutoff;
+    for (;;) {
+      int b = 0;
+      for (size_t dim = Dim; dim-- > 0; )
+        b = b * side[dim] + c[dim];
+      STATS_COUNT(COUNTER_LEAF_PAIRS, start[b + 1] - start[b]);
+      for (int j = start[b]; j < start[b + 1]; j++) {
+        Vector<T, Dim> diff = orig - pts[j];
+        T d2 = diff.norm2();
+        if (d2 > 0 && d2 < cutoff2)
+          res += diff / d2;
+      }
+      // next cell of the neighbourhood, first coordinate fastest
+      size_t dim = 0;
+      for (; dim < Dim && c[dim] == to[dim]; dim++)
+        c[dim] = from[dim];
+      if (dim == Dim) break;
+      c[dim]++;
+    }
+    return res;
+  }
+
+  int threads;
+protected:
+  int coordinate(const Vector<T, Dim>& x, size_t dim) const {
+    T t = (x[dim] - lo[dim]) / size;
+    return t <= 0 ? 0 : t >= side[dim] - 1 ? side[dim] - 1 : int(t);
+  }
+  int index(const Vector<T, Dim>& x) const {
+    int b = 0;
+    for (size_t dim = Dim; dim-- > 0; )
+      b = b * side[dim] + coordinate(x, dim);
+    return b;
+  }
+
+  T cutoff, size;
+  array<T, Dim> lo, hi;
+  int side[Dim]; // cells along each axis
+  vector<int> cell, start, fill; // points in cell b are pts[start[b]..start[b+1])
+  vector<Vector<T, Dim>> pts;
+};
+
+#endif /* end of include guard: GRID_HH */
@@ -0,0 +1,46 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Input.hh"
+
+InputBuffer::~InputBuffer()
+{
+  if (mapped)
+    munmap(const_cast<char*>(data), size);
+}
+
+bool InputBuffer::open(const char* path)
+{
+  int fd = path ? ::open(path, O_RDONLY) : 0;
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    void* p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p != MAP_FAILED) {
+      madvise(p, st.st_size, MADV_SEQUENTIAL);
+      data = static_cast<const char*>(p);
+      size = st.st_size;
+      mapped = true;
+      if (path) close(fd);
+      return true;
+    }
+  }
+  // a pipe, or a file that cannot be mapped
+  buf.resize(1 << 16);
+  size = 0;
+  for (ssize_t r; (r = read(fd, buf.data() + size, buf.size() - size)) != 0; ) {
+    if (r < 0) {
+      if (errno == EINTR) continue;
+      if (path) close(fd);
+      return false;
+    }
+    size += r;
+    if (size == buf.size())
+      buf.resize(buf.size() * 2);
+  }
+  if (path) close(fd);
+  data = buf.data();
+  return true;
+}
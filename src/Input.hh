@@ -0,0 +1,289 @@
+#ifndef INPUT_HH
+#define INPUT_HH
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include "Core.hh"
+#include "Output.hh"
+
+enum InputFormat { INPUT_TEXT, INPUT_BINARY };
+
+// The whole input in memory: a read-only mapping of a regular file, or what
+// could be read from a pipe
+class InputBuffer
+{
+public:
+  InputBuffer() : data(NULL), size(0), mapped(false) {}
+  InputBuffer(const InputBuffer&) = delete;
+  InputBuffer& operator=(const InputBuffer&) = delete;
+  ~InputBuffer();
+  // NULL reads stdin; false with errno set on failure
+  bool open(const char* path);
+
+  const char* data;
+  size_t size;
+protected:
+  vector<char> buf;
+  bool mapped;
+};
+
+// Binary edge list, in native byte order:
+//   BinaryGraphHeader
+//   int32_t u[m], v[m]
+//   double w[m]           if flags & BINARY_WEIGHTED
+struct BinaryGraphHeader
+{
+  char magic[4]; // "FDGB"
+  uint32_t flags;
+  uint64_t n, m;
+};
+const uint32_t BINARY_WEIGHTED = 1;
+
+// Edges of a binary graph read in place from its arrays
+template<typename T>
+struct BinaryEdgeIterator
+{
+  typedef typename Graph<T>::Edge Edge;
+  struct Arrow {
+    Edge e;
+    const Edge* operator->() const { return &e; }
+  };
+  Edge operator*() const {
+    Edge e = {u[i], v[i], w ? T(w[i]) : T(1)};
+    return e;
+  }
+  Arrow operator->() const {
+    Arrow a = {**this};
+    return a;
+  }
+  BinaryEdgeIterator& operator++() { i++; return *this; }
+  bool operator!=(const BinaryEdgeIterator& r) const { return i != r.i; }
+
+  const int32_t *u, *v;
+  const double* w;
+  size_t i;
+};
+
+// Without `weighted' all edges weigh 1 and weights in a binary file are
+// ignored. False on malformed input. The bytes taken go to *used, so that
+// graphs can follow one another.
+template<typename T>
+bool parseBinaryGraph(const char* data, size_t size, bool weighted, Graph<T>& g, size_t* used = NULL)
+{
+  BinaryGraphHeader h;
+  if (size < sizeof h) return false;
+  memcpy(&h, data, sizeof h);
+  if (memcmp(h.magic, "FDGB", 4) || h.n > uint64_t(numeric_limits<int>::max()) || h.m > uint64_t(numeric_limits<int>::max()) / 2)
+    return false;
+  bool has_w = h.flags & BINARY_WEIGHTED;
+  size_t total = sizeof h + h.m * (2 * sizeof(int32_t) + (has_w ? sizeof(double) : 0));
+  if (size < total)
+    return false;
+  int n = h.n;
+  BinaryEdgeIterator<T> first, last;
+  first.u = reinterpret_cast<const int32_t*>(data + sizeof h);
+  first.v = first.u + h.m;
+  first.w = has_w && weighted ? reinterpret_cast<const double*>(first.v + h.m) : NULL;
+  first.i = 0;
+  last = first;
+  last.i = h.m;
+  for (size_t i = 0; i < h.m; i++)
+    if (! (0 <= first.u[i] && first.u[i] < n && 0 <= first.v[i] && first.v[i] < n) || (first.w && ! (0 <= first.w[i])))
+      return false;
+  g = Graph<T>(n, first, last);
+  if (used)
+    *used = total;
+  return true;
+}
+
+// Scanning of the text format without the C library's locale and format
+// string machinery
+struct TextScanner
+{
+  TextScanner(const char* p, const char* end) : p(p), end(end) {}
+  void skip() {
+    while (p < end && (*p == ' ' || *p == '\n' || *p == '\t' || *p == '\r'))
+      p++;
+  }
+  bool integer(int& x) {
+    skip();
+    bool neg = p < end && *p == '-';
+    if (neg) p++;
+    const char* start = p;
+    int64_t r = 0;
+    for (; p < end && '0' <= *p && *p <= '9' && r <= numeric_limits<int>::max(); p++)
+      r = r * 10 + (*p - '0');
+    if (p == start || r > numeric_limits<int>::max()) return false;
+    x = int(neg ? - r : r);
+    return true;
+  }
+  // Decimals whose digits fit in a double's mantissa are one division by a
+  // power of ten; anything else goes through strtod
+  bool real(double& x) {
+    static const double pow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    skip();
+    const char* start = p;
+    bool neg = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+')) p++;
+    uint64_t mant = 0;
+    int digits = 0, frac = 0;
+    for (; p < end && '0' <= *p && *p <= '9'; p++, digits++)
+      mant = mant * 10 + (*p - '0');
+    if (p < end && *p == '.')
+      for (p++; p < end && '0' <= *p && *p <= '9'; p++, digits++, frac++)
+        mant = mant * 10 + (*p - '0');
+    if (digits == 0) return false;
+    if (digits <= 19 && mant < (uint64_t(1) << 53) && ! (p < end && (*p == 'e' || *p == 'E'))) {
+      x = double(mant) / pow10[frac < 22 ? frac : 22];
+      if (frac > 22) x /= std::pow(10.0, frac - 22);
+      if (neg) x = - x;
+      return true;
+    }
+    // strtod needs a terminated copy as the input may end right here
+    while (p < end && (('0' <= *p && *p <= '9') || *p == 'e' || *p == 'E' || *p == '-' || *p == '+' || *p == '.'))
+      p++;
+    std::string s(start, p);
+    char* e;
+    x = strtod(s.c_str(), &e);
+    return *e == '\0';
+  }
+
+  const char *p, *end;
+};
+
+// n m, then m lines of u v, or u v w if `weighted'
+template<typename T>
+bool parseTextGraph(TextScanner& in, bool weighted, Graph<T>& g)
+{
+  int n, m;
+  if (! in.integer(n) || ! in.integer(m) || n < 0 || m < 0)
+    return false;
+  // m is only trusted as far as the rest of the input can hold that many
+  // edges, each a separator and at least "u v"
+  vector<typename Graph<T>::Edge> edges;
+  edges.reserve(min(size_t(m), size_t(in.end - in.p) / 4 + 1));
+  for (int i = 0; i < m; i++) {
+    typename Graph<T>::Edge e;
+    double w = 1;
+    if (! in.integer(e.u) || ! in.integer(e.v) || ! (0 <= e.u && e.u < n && 0 <= e.v && e.v < n))
+      return false;
+    if (weighted)
+      if (! in.real(w) || ! (0 <= w))
+        return false;
+    e.w = T(w);
+    edges.push_back(e);
+  }
+  g = Graph<T>(n, edges.begin(), edges.end());
+  return true;
+}
+
+template<typename T>
+bool parseTextGraph(const char* data, size_t size, bool weighted, Graph<T>& g)
+{
+  TextScanner in(data, data + size);
+  return parseTextGraph(in, weighted, g);
+}
+
+// NULL reads stdin. False on malformed input, and with errno set if the
+// input cannot be read.
+template<typename T>
+bool readGraph(const char* path, InputFormat format, bool weighted, Graph<T>& g)
+{
+  InputBuffer in;
+  if (! in.open(path))
+    return false;
+  errno = 0;
+  if (format == INPUT_BINARY)
+    return parseBinaryGraph(in.data, in.size, weighted, g);
+  return parseTextGraph(in.data, in.size, weighted, g);
+}
+
+// Graphs one after another in one input, as for batch layout
+class GraphStream
+{
+public:
+  GraphStream(InputFormat format, bool weighted) : format(format), weighted(weighted), error(false), text(NULL, NULL) {}
+  // NULL reads stdin; false with errno set on failure
+  bool open(const char* path) {
+    if (! in.open(path))
+      return false;
+    text = TextScanner(in.data, in.data + in.size);
+    return true;
+  }
+  // False at the end of the input, or on malformed input with error set
+  template<typename T>
+  bool next(Graph<T>& g) {
+    text.skip();
+    if (text.p == text.end)
+      return false;
+    bool ok;
+    if (format == INPUT_BINARY) {
+      size_t used = 0;
+      ok = parseBinaryGraph(text.p, text.end - text.p, weighted, g, &used);
+      text.p += used;
+    } else
+      ok = parseTextGraph(text, weighted, g);
+    error |= ! ok;
+    return ok;
+  }
+
+  InputFormat format;
+  bool weighted;
+  // a graph was malformed
+  bool error;
+protected:
+  InputBuffer in;
+  TextScanner text;
+};
+
+// A layout as written by writeLayout: binary (recognized by its header,
+// of any coordinate size) or text, Dim numbers per vertex. NULL reads stdin.
+// False on malformed input, and with errno set if it cannot be read.
+template<typename T, size_t Dim>
+bool readLayout(const char* path, vector<Vector<T, Dim>>& pos)
+{
+  InputBuffer in;
+  if (! in.open(path))
+    return false;
+  errno = 0;
+  BinaryLayoutHeader h;
+  if (in.size >= sizeof h && ! memcmp(in.data, "FDGL", 4)) {
+    memcpy(&h, in.data, sizeof h);
+    if (h.dim != Dim || (h.size != sizeof(float) && h.size != sizeof(double)) || (in.size - sizeof h) / (Dim * h.size) < h.n)
+      return false;
+    pos.resize(h.n);
+    const char* p = in.data + sizeof h;
+    for (auto& x : pos)
+      for (size_t dim = 0; dim < Dim; dim++, p += h.size) {
+        double d;
+        if (h.size == sizeof(float)) {
+          float f;
+          memcpy(&f, p, sizeof f);
+          d = f;
+        } else
+          memcpy(&d, p, sizeof d);
+        x[dim] = T(d);
+      }
+    return true;
+  }
+  TextScanner s(in.data, in.data + in.size);
+  pos.clear();
+  for (;;) {
+    s.skip();
+    if (s.p == s.end)
+      return true;
+    Vector<T, Dim> x;
+    for (size_t dim = 0; dim < Dim; dim++) {
+      double d;
+      if (! s.real(d))
+        return false;
+      x[dim] = T(d);
+    }
+    pos.push_back(x);
+  }
+}
+
+#endif /* end of include guard: INPUT_HH */
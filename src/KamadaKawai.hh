@@ -1,9 +1,13 @@
 #ifndef KAMADAKAWAI_HH
 #define KAMADAKAWAI_HH
 
+#include <errno.h>
 #include <string.h>
 #include <stdlib.h>
 #include "Core.hh"
+#include "DistanceMatrix.hh"
+#include "Parallel.hh"
+#include "ShortestPath.hh"
 
 template <size_t Size>
 struct LinearSolver {};
@@ -11,8 +15,8 @@ struct LinearSolver {};
 template <>
 struct LinearSolver<1>
 {
-  template<typename Vec>
-    static Vec solve(double mat[1][1], Vec rhs) {
+  template<typename T, typename Vec>
+    static Vec solve(T mat[1][1], Vec rhs) {
       return rhs / mat[0][0];
     }
 };
@@ -21,11 +25,11 @@ struct LinearSolver<1>
 template <>
 struct LinearSolver<2>
 {
-  template <typename Vec>
-    static Vec solve(double mat[2][2], Vec rhs) {
-      double denom = mat[0][0] * mat[1][1] - mat[1][0] * mat[0][1];
-      double x_num = rhs[0]    * mat[1][1] - rhs[1]    * mat[0][1];
-      double y_num = mat[0][0] * rhs[1]    - mat[1][0] * rhs[0]   ;
+  template <typename T, typename Vec>
+    static Vec solve(T mat[2][2], Vec rhs) {
+      T denom = mat[0][0] * mat[1][1] - mat[1][0] * mat[0][1];
+      T x_num = rhs[0]    * mat[1][1] - rhs[1]    * mat[0][1];
+      T y_num = mat[0][0] * rhs[1]    - mat[1][0] * rhs[0]   ;
       Vec result;
       result[0] = x_num / denom;
       result[1] = y_num / denom;
@@ -36,18 +40,18 @@ struct LinearSolver<2>
 template <>
 struct LinearSolver<3>
 {
-  template <typename Vec>
-    static Vec solve(double mat[2][2], Vec rhs) {
-      double denom = mat[0][0] * (mat[1][1] * mat[2][2] - mat[2][1] * mat[1][2])
+  template <typename T, typename Vec>
+    static Vec solve(T mat[3][3], Vec rhs) {
+      T denom = mat[0][0] * (mat[1][1] * mat[2][2] - mat[2][1] * mat[1][2])
         - mat[1][0] * (mat[0][1] * mat[2][2] - mat[2][1] * mat[0][2])
         + mat[2][0] * (mat[0][1] * mat[1][2] - mat[1][1] * mat[0][2]);
-      double x_num = rhs[0]    * (mat[1][1] * mat[2][2] - mat[2][1] * mat[1][2])
+      T x_num = rhs[0]    * (mat[1][1] * mat[2][2] - mat[2][1] * mat[1][2])
         - rhs[1]    * (mat[0][1] * mat[2][2] - mat[2][1] * mat[0][2])
         + rhs[2]    * (mat[0][1] * mat[1][2] - mat[1][1] * mat[0][2]);
-      double y_num = mat[0][0] * (rhs[1]    * mat[2][2] - rhs[2]    * mat[1][2])
+      T y_num = mat[0][0] * (rhs[1]    * mat[2][2] - rhs[2]    * mat[1][2])
         - mat[1][0] * (rhs[0]    * mat[2][2] - rhs[2]    * mat[0][2])
         + mat[2][0] * (rhs[0]    * mat[1][2] - rhs[1]    * mat[0][2]);
-      double z_num = mat[0][0] * (mat[1][1] * rhs[2]    - mat[2][1] * rhs[1]   )
+      T z_num = mat[0][0] * (mat[1][1] * rhs[2]    - mat[2][1] * rhs[1]   )
         - mat[1][0] * (mat[0][1] * rhs[2]    - mat[2][1] * rhs[0]   )
         + mat[2][0] * (mat[0][1] * rhs[1]    - mat[1][1] * rhs[0]   );
       Vec result;
@@ -62,136 +66,278 @@ template<typename T, size_t Dim>
 struct KamadaKawai : ForceDirectedDrawing<T, Dim>
 {
   using ForceDirectedDrawing<T, Dim>::space;
+  using ForceDirectedDrawing<T, Dim>::threads;
 
   KamadaKawai(const array<T, Dim>& space)
     : ForceDirectedDrawing<T, Dim>(space)
       , tolerance(1e-6)
-      , spring_strength(1) {}
+      , spring_strength(1)
+      , storage(STORAGE_NATIVE)
+      , distance_file(NULL) {}
   void set(const char* option, const char* value) {
     if (! strcmp(option, "tolerance"))
       tolerance = atof(value);
   }
+  virtual KamadaKawai* clone() const { return new KamadaKawai(*this); }
   virtual void operator()(const Graph<T>& g, vector<Vector<T, Dim>>& pos) {
-    vector<vector<T>> dist(g.n, vector<T>(g.n, numeric_limits<T>::max())),
-      strength(g.n, vector<T>(g.n));
-    for (int u = 0; u < g.n; u++)
-      for (typename Graph<T>::It j = g.e[u].begin(); j != g.e[u].end(); j++)
-        dist[u][j->first] = dist[j->first][u] = j->second;
-    for (int u = 0; u < g.n; u++)
-      dist[u][u] = T(0);
-    // Floyd-Warshall
-    // TODO resort to Johnson's in a sparse graph
-    for (int p = 0; p < g.n; p++)
+    this->interrupted = false;
+    this->error = 0;
+    if (storage == STORAGE_HOPS && uniformWeights(g) && hopsFit(g)) {
+      hop_matrix.unit = g.weight.empty() ? T(1) : g.weight[0];
+      layoutWith(g, pos, hop_matrix);
+    } else if (storage != STORAGE_NATIVE)
+      layoutWith(g, pos, float_matrix);
+    else
+      layoutWith(g, pos, matrix);
+  }
+
+  // Encoding of graph distances; hop counts apply only when all edges weigh
+  // the same and every distance is below 65535 hops, and fall back to float
+  // otherwise
+  enum Storage { STORAGE_NATIVE, STORAGE_FLOAT, STORAGE_HOPS };
+
+  T tolerance, spring_strength;
+  Storage storage;
+  // if set, the distance matrix is a mapping of this file
+  const char* distance_file;
+
+protected:
+  // kept between calls, one matrix per storage
+  DistanceMatrix<T, T> matrix;
+  DistanceMatrix<T, float> float_matrix;
+  DistanceMatrix<T, uint16_t> hop_matrix;
+  vector<Vector<T, Dim>> partials, p_partials;
+  vector<SearchBuffers<T>> searches;
+
+  // Whether every hop count of g is below the infinity of hop_matrix. It is
+  // below n, and at most twice the eccentricity of any vertex of its
+  // component, which one search per component finds.
+  bool hopsFit(const Graph<T>& g) {
+    const int most = numeric_limits<uint16_t>::max() - 1;
+    if (g.n <= most + 1)
+      return true;
+    if (searches.empty())
+      searches.resize(1);
+    vector<T>& level = searches[0].dist;
+    vector<int>& queue = searches[0].queue;
+    level.assign(g.n, T(-1));
+    queue.resize(g.n);
+    for (int s = 0; s < g.n; s++)
+      if (level[s] < 0) {
+        int head = 0, tail = 0;
+        level[s] = 0;
+        queue[tail++] = s;
+        while (head < tail) {
+          int u = queue[head++];
+          if (2 * level[u] > most)
+            return false;
+          for (int j = g.offset[u]; j < g.offset[u + 1]; j++)
+            if (level[g.adj[j]] < 0) {
+              level[g.adj[j]] = level[u] + 1;
+              queue[tail++] = g.adj[j];
+            }
+        }
+      }
+    return true;
+  }
+
+  template<typename M>
+  void layoutWith(const Graph<T>& g, vector<Vector<T, Dim>>& pos, M& dist) {
+    if (! dist.resize(g.n, distance_file)) {
+      this->error = errno;
+      return;
+    }
+    layout(g, pos, dist);
+    // a mapping is not kept beyond the call
+    if (distance_file)
+      dist.resize(0);
+  }
+
+  // graph distances of every pair into the upper triangle of `dist'
+  template<typename M>
+  void shortestPaths(const Graph<T>& g, M& dist) {
+    STATS_PHASE(PHASE_APSP);
+    const T inf = numeric_limits<T>::max();
+    if (preferFloydWarshall(g)) {
       for (int u = 0; u < g.n; u++)
-        for (int v = 0; v < g.n; v++)
-          dist[u][v] = min(dist[u][v], dist[u][p] + dist[p][v]);
+        for (int j = g.offset[u]; j < g.offset[u + 1]; j++)
+          if (g.adj[j] != u)
+            dist.set(u, g.adj[j], min(dist.get(u, g.adj[j]), g.weight[j]));
+      // Floyd-Warshall over the upper triangle, rows relaxed in parallel for
+      // each p. Row u writes (u, v > u) and reads (u, p), (p, v), which no
+      // row writes in the same round.
+      for (int p = 0; p < g.n; p++)
+        parallelFor(threads, g.n, [&](int u) {
+          T dup = dist.get(u, p);
+          if (u == p || dup == inf) return;
+          for (int v = u + 1; v < g.n; v++)
+            if (v != p) {
+              T dpv = dist.get(p, v);
+              if (dpv != inf && dup + dpv < dist.get(u, v))
+                dist.set(u, v, dup + dpv);
+            }
+        }, 16);
+    } else
+      allPairsShortestPaths(g, threads, [&](int s, const vector<T>& d) {
+        for (int v = s + 1; v < g.n; v++)
+          dist.set(s, v, d[v]);
+      }, searches);
+  }
 
-    double edge_length = 0;
-    for (int u = 0; u < g.n; u++)
-      for (int v = u; ++v < g.n; )
-        edge_length = max(edge_length, dist[u][v]);
-    edge_length = *std::max_element(space.begin(), space.end()) / edge_length;
+  template<typename M>
+  void layout(const Graph<T>& g, vector<Vector<T, Dim>>& pos, M& dist) {
+    shortestPaths(g, dist);
+
+    // vertices of different components are held as far apart as the
+    // farthest connected pair
+    const T inf = numeric_limits<T>::max();
+    T far = 0;
     for (int u = 0; u < g.n; u++)
       for (int v = u; ++v < g.n; ) {
-        T d = dist[u][v];
-        dist[u][v] = dist[v][u] = edge_length * d;
-        strength[u][v] = strength[v][u] = spring_strength / (d * d);
+        T d = dist.get(u, v);
+        if (d != inf)
+          far = max(far, d);
       }
+    if (far == 0)
+      far = 1;
+    T edge_length = *std::max_element(space.begin(), space.end()) / far;
+    // ideal length and strength of the spring between u and v, derived from
+    // their graph distance on every use rather than kept in another matrix
+    auto spring = [&](int u, int v, T& l, T& k) {
+      T d = dist.get(u, v);
+      if (d == inf)
+        d = far;
+      l = edge_length * d;
+      k = spring_strength / (d * d);
+    };
 
     // contribution of vertex v to vertex u
-    function<Vector<T, Dim>(int, int)> compute_partial_deriv = [&](int u, int v) {
+    auto compute_partial_deriv = [&](int u, int v) {
       if (u == v) {
         Vector<T, Dim> res = {};
         res.fill(T(0));
         return res;
       }
       Vector<T, Dim> diff = pos[u] - pos[v];
-      T l = dist[u][v];
+      T l, k;
+      spring(u, v, l, k);
       T d = diff.norm();
-      return (diff - diff * (l / d)) * strength[u][v];
+      return (diff - diff * (l / d)) * k;
     };
-    function<Vector<T, Dim>(int)> compute_partial_derivs = [&](int u) {
+    auto compute_partial_derivs = [&](int u) {
       Vector<T, Dim> res = {};
       for (int v = 0; v < g.n; v++)
         res += compute_partial_deriv(u, v);
       return res;
     };
 
-    // find the most promising vertex
-    LayoutTolerance done(tolerance);
-    int pivot = 0;
+    // Energy terms, gradient and Jacobi matrix of pivot p in one pass over its row
+    auto sweep = [&](int p, T& E_p, Vector<T, Dim>& grad, T (*ddE)[Dim]) {
+      E_p = 0;
+      grad.fill(T(0));
+      for (size_t i = 0; i < Dim; i++)
+        for (size_t j = 0; j < Dim; j++)
+          ddE[i][j] = 0;
+      for (int u = 0; u < g.n; u++)
+        if (p != u) {
+          auto diff = pos[p] - pos[u];
+          T d2 = diff.norm2(), d = sqrt(d2), inv_d3 = T(1) / (d2 * d), l, k;
+          spring(p, u, l, k);
+          E_p += T(0.5) * k * (d - l) * (d - l);
+          grad += (diff - diff * (l / d)) * k;
+          for (size_t i = 0; i < Dim; i++)
+            for (size_t j = 0; j < Dim; j++)
+              if (i == j)
+                ddE[i][j] += k * (T(1) + (l * (diff[i] * diff[i] - d2) * inv_d3));
+              else
+                ddE[i][j] += k * l * diff[i] * diff[j] * inv_d3;
+        }
+    };
+
+    // find the most promising vertex; frozen ones are never pivots
+    int pivot = -1;
     T max_delta(0);
-    vector<Vector<T, Dim>> partials(g.n);
+    partials.resize(g.n);
+    p_partials.resize(g.n);
     for (int u = 0; u < g.n; u++) {
       partials[u] = compute_partial_derivs(u);
       T delta = partials[u].norm();
-      if (delta > max_delta) {
+      if (this->mobility(u) > 0 && (pivot < 0 || delta > max_delta)) {
         pivot = u;
         max_delta = delta;
       }
     }
+    // gradients below the rounding noise of their sums are not asked for,
+    // which matters with float
+    LayoutTolerance done(max(tolerance, max_delta * numeric_limits<T>::epsilon() * 100));
+    // total energy, kept up to date as single vertices move
+    double E = 0;
+    for (int u = 0; u < g.n; u++)
+      for (int v = u; ++v < g.n; ) {
+        T l, k;
+        spring(u, v, l, k);
+        double d = (pos[u] - pos[v]).norm();
+        E += 0.5 * k * pow(d-l, 2);
+      }
 
-    while (! done(max_delta, true)) {
-      vector<Vector<T, Dim>> p_partials(g.n);
+    STATS_PHASE(PHASE_DISPLACEMENT);
+    this->iterations_run = 0;
+    while (pivot >= 0 && ! this->expired() && ! done(max_delta, true)) {
+      this->iterations_run++;
+      STATS_COUNT(COUNTER_PIVOTS, 1);
+#ifdef ENABLE_STATS
+      Vector<T, Dim> from = pos[pivot];
+#endif
       for (int u = 0; u < g.n; u++)
         p_partials[u] = compute_partial_deriv(u, pivot);
-      // tune vertex pivot with Newton-Raphson method
+      // tune vertex pivot with Newton-Raphson method; only the pivot's row of
+      // the energy changes, so each step costs one sweep over that row
+      T ddE[Dim][Dim], E_p;
+      Vector<T, Dim> grad;
+      sweep(pivot, E_p, grad, ddE);
       double last_E = numeric_limits<T>::max();
       do {
-        // Jacobi matrix
-        T ddE[Dim][Dim] = {};
-        for (int u = 0; u < g.n; u++)
-          if (pivot != u) {
-            auto diff = pos[pivot] - pos[u];
-            T d2 = diff.norm2(), d = sqrt(d2), inv_d3 = T(1) / (d2 * d),
-              l = dist[pivot][u],
-              k = strength[pivot][u];
-            for (size_t i = 0; i < Dim; i++)
-              for (size_t j = 0; j < Dim; j++)
-                if (i == j)
-                  ddE[i][j] += k * (T(1) + (l * (diff[i] * diff[i] - d2) * inv_d3));
-                else
-                  ddE[i][j] += k * l * diff[i] * diff[j] * inv_d3;
-          }
-
-        auto step = LinearSolver<Dim>::solve(ddE, - partials[pivot]);
+        STATS_COUNT(COUNTER_NEWTON_STEPS, 1);
+        auto step = LinearSolver<Dim>::solve(ddE, - partials[pivot]) * this->mobility(pivot);
         for (size_t dim = 0; dim < Dim; dim++)
           pos[pivot][dim] += step[dim];
 
-        double E = 0;
-        for (int u = 0; u < g.n; u++)
-          for (int v = u; ++v < g.n; ) {
-            double l = dist[u][v],
-                   d = (pos[u] - pos[v]).norm();
-            E += 0.5 * strength[u][v] * pow(d-l, 2);
-          }
-
-        if (E > last_E) {
+        T new_E_p;
+        sweep(pivot, new_E_p, grad, ddE);
+        double new_E = E - E_p + new_E_p;
+        if (new_E > last_E) {
           for (size_t dim = 0; dim < Dim; dim++)
             pos[pivot][dim] -= step[dim];
           goto L1;
         }
-        last_E = E;
-        fprintf(stderr, "E = %lf %d\n", E, pivot);
+        // steps within rounding of the minimum leave the energy as it is
+        bool stalled = new_E == last_E;
+        last_E = E = new_E;
+        E_p = new_E_p;
 
-        partials[pivot] = compute_partial_derivs(pivot);
+        partials[pivot] = grad;
         max_delta = partials[pivot].norm();
+        if (stalled) break;
       } while (! done(max_delta, false));
+      STATS_ITERATION(E, pos[pivot].dist(from));
 
       int old_p = pivot;
       for (int u = 0; u < g.n; u++) {
         auto old = p_partials[u], new_ = compute_partial_deriv(u, old_p);
         partials[u] += new_ - old;
         T delta = partials[u].norm();
-        if (delta > max_delta) {
+        if (delta > max_delta && this->mobility(u) > 0) {
           pivot = u;
           max_delta = delta;
         }
       }
+      if (! this->proceed(pos, this->iterations_run))
+        break;
     }
 L1:
 
-    normalizeToSpace(pos, space);
+    if (! this->warm)
+      normalizeToSpace(pos, space);
   }
 
   struct LayoutTolerance
@@ -225,8 +371,6 @@ L1:
     }
     T tolerance, last, last_l;
   };
-
-  T tolerance, spring_strength;
 };
 
 #endif /* end of include guard: KAMADAKAWAI_HH */
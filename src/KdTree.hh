@@ -3,98 +3,147 @@
 
 #include <vector>
 #include "Core.hh"
+#include "Parallel.hh"
 
+// Nodes live in one array in preorder, so a child always follows its parent.
+// The tree is meant to be kept by a layout engine and built again after
+// every move, reusing its arrays. (Refitting the boxes of the old tree
+// instead was slower overall: the refitted tree takes longer to walk than a
+// new one takes to build.)
 template<typename T, size_t Dim>
 class KdTree
 {
 public:
-  KdTree(const vector<Vector<T, Dim>>& coords, T alpha)
-    : coords(coords)
-      , alpha(alpha)
-      , node_size_threashold(4) {
-      root = build(0, coords.size(), 0);
-    }
-  ~KdTree() { delete root; }
+  KdTree(T alpha = 1.5)
+    : alpha(alpha)
+      , node_size_threashold(4)
+      , threads(1) {}
   struct Node {
     Cube<T, Dim> bounding; // minimum bounding box
     Vector<T, Dim> sum; // sum of coordinates in subtree
-    int L, R; // coords[L..R)
-    Node* ch[2];
-    Node() { ch[0] = ch[1] = NULL; }
-    ~Node() { delete ch[0]; delete ch[1]; }
-    bool isLeaf() { return ch[0] == NULL && ch[1] == NULL; }
+    int L, R; // pts[L..R)
+    int ch[2];
+    bool isLeaf() const { return ch[0] < 0; }
   };
-  Vector<T, Dim> getRepulsive(const Vector<T, Dim>& orig) {
-    return getRepulsive(root, orig);
+  void build(const vector<Vector<T, Dim>>& coords) {
+    idx.resize(coords.size());
+    for (size_t i = 0; i < idx.size(); i++)
+      idx[i] = i;
+    nodes.resize(subtreeSize(coords.size()));
+    if (! coords.empty())
+      build(coords, 0, coords.size(), 0, 0, threads);
+    gather(coords);
+    fit();
+  }
+  Vector<T, Dim> getRepulsive(const Vector<T, Dim>& orig) const {
+    if (nodes.empty()) {
+      Vector<T, Dim> res;
+      res.fill(0);
+      return res;
+    }
+    return getRepulsive(0, orig);
   }
+
+  T alpha;
+  size_t node_size_threashold;
+  int threads;
 protected:
-  Node* build(int L, int R, size_t dim) {
-    if (L == R) return NULL;
-    Node* rt = new Node;
-    rt->L = L;
-    rt->R = R;
-    if (R - L <= node_size_threashold) {
-      rt->sum.fill(0);
-      rt->bounding.lo = rt->bounding.hi = coords[L];
-      for (int i = L; i < R; i++) {
-        rt->sum += coords[i];
+  // number of nodes over `len' points
+  int subtreeSize(int len) const { return subtreeSizes(len).first; }
+  // numbers of nodes over `len' and `len + 1' points, in O(log len)
+  pair<int, int> subtreeSizes(int len) const {
+    if (size_t(len + 1) <= node_size_threashold)
+      return std::make_pair(len ? 1 : 0, 1);
+    auto h = subtreeSizes(len / 2);
+    if (len % 2 == 0)
+      return std::make_pair(size_t(len) <= node_size_threashold ? 1 : 1 + 2 * h.first, 1 + h.first + h.second);
+    return std::make_pair(size_t(len) <= node_size_threashold ? 1 : 1 + h.first + h.second, 1 + 2 * h.second);
+  }
+  // Subtree over idx[L..R) rooted at nodes[rt]; the left child is nodes[rt+1]
+  // and the right one follows the left subtree, so both halves can be built by
+  // different threads.
+  void build(const vector<Vector<T, Dim>>& coords, int L, int R, size_t dim, int rt, int threads) {
+    nodes[rt].L = L;
+    nodes[rt].R = R;
+    nodes[rt].ch[0] = nodes[rt].ch[1] = -1;
+    if (size_t(R - L) > node_size_threashold) {
+      int M = (L + R) / 2;
+      std::nth_element(idx.begin() + L, idx.begin() + M, idx.begin() + R,
+          [&](int l, int r) { return coords[l][dim] < coords[r][dim]; });
+      int c0 = rt + 1, c1 = c0 + subtreeSize(M - L);
+      nodes[rt].ch[0] = c0;
+      nodes[rt].ch[1] = c1;
+      parallelInvoke(threads > 1,
+          [&]() { build(coords, L, M, (dim + 1) % Dim, c0, threads / 2); },
+          [&]() { build(coords, M, R, (dim + 1) % Dim, c1, threads - threads / 2); });
+    }
+  }
+  void gather(const vector<Vector<T, Dim>>& coords) {
+    pts.resize(idx.size());
+    for (size_t i = 0; i < idx.size(); i++)
+      pts[i] = coords[idx[i]];
+  }
+  // bottom-up: children come after their parent
+  void fit() {
+    for (int i = int(nodes.size()) - 1; i >= 0; i--) {
+      Node& rt = nodes[i];
+      if (rt.isLeaf()) {
+        rt.sum.fill(0);
+        rt.bounding.lo = rt.bounding.hi = pts[rt.L];
+        for (int j = rt.L; j < rt.R; j++) {
+          rt.sum += pts[j];
+          for (size_t dim = 0; dim < Dim; dim++) {
+            rt.bounding.lo[dim] = min(rt.bounding.lo[dim], pts[j][dim]);
+            rt.bounding.hi[dim] = max(rt.bounding.hi[dim], pts[j][dim]);
+          }
+        }
+      } else {
+        const Node &l = nodes[rt.ch[0]], &r = nodes[rt.ch[1]];
+        rt.sum = l.sum + r.sum;
+        rt.bounding = l.bounding;
         for (size_t dim = 0; dim < Dim; dim++) {
-          rt->bounding.lo[dim] = min(rt->bounding.lo[dim], coords[i][dim]);
-          rt->bounding.hi[dim] = max(rt->bounding.hi[dim], coords[i][dim]);
+          rt.bounding.lo[dim] = min(rt.bounding.lo[dim], r.bounding.lo[dim]);
+          rt.bounding.hi[dim] = max(rt.bounding.hi[dim], r.bounding.hi[dim]);
         }
       }
-    } else {
-      int M = (L + R) / 2;
-      std::nth_element(coords.begin() + L, coords.begin() + M, coords.begin() + R,
-          [&](const Vector<T, Dim>& l, const Vector<T, Dim>& r) { return l[dim] < r[dim]; });
-      T median = coords[M][dim];
-
-      rt->ch[0] = build(L, M, (dim + 1) % Dim);
-      rt->ch[1] = build(M, R, (dim + 1) % Dim);
-
-      rt->sum = rt->ch[0]->sum + rt->ch[1]->sum;
-      rt->bounding = rt->ch[0]->bounding;
-      for (size_t dim = 0; dim < Dim; dim++) {
-        rt->bounding.lo[dim] = min(rt->bounding.lo[dim], rt->ch[1]->bounding.lo[dim]);
-        rt->bounding.hi[dim] = max(rt->bounding.hi[dim], rt->ch[1]->bounding.hi[dim]);
-      }
     }
-    return rt;
   }
-  Vector<T, Dim> getRepulsive(Node* rt, const Vector<T, Dim>& orig) {
-    if (rt == NULL) {
-      Vector<T, Dim> res;
-      res.fill(0);
-      return res;
-    }
-    if (rt->isLeaf()) {
+  static T measure(const Node& rt) {
+    T res(0);
+    for (size_t dim = 0; dim < Dim; dim++)
+      res = max(res, rt.bounding.hi[dim] - rt.bounding.lo[dim]);
+    return res;
+  }
+  Vector<T, Dim> getRepulsive(int i, const Vector<T, Dim>& orig) const {
+    const Node& rt = nodes[i];
+    STATS_COUNT(COUNTER_NODES_VISITED, 1);
+    if (rt.isLeaf()) {
+      STATS_COUNT(COUNTER_LEAF_PAIRS, rt.R - rt.L);
       Vector<T, Dim> res;
       res.fill(0);
-      for (int i = rt->L; i < rt->R; i++)
-        if (orig != coords[i]) { // exclude itself
-          Vector<T, Dim> diff = orig - coords[i];
+      for (int j = rt.L; j < rt.R; j++)
+        if (orig != pts[j]) { // exclude itself
+          Vector<T, Dim> diff = orig - pts[j];
           res += diff.unit() / diff.norm();
         }
       return res;
     }
 
     // approximate
-    T measure(0);
-    Vector<T, Dim> barycenter = rt->sum / (rt->R - rt->L);
-    for (size_t dim = 0; dim < Dim; dim++)
-      measure = max(measure, rt->bounding.hi[dim] - rt->bounding.lo[dim]);
+    Vector<T, Dim> barycenter = rt.sum / (rt.R - rt.L);
     auto diff = orig - barycenter;
     T d = diff.norm();
-    if (d / measure > alpha)
-      return diff.unit() / d * (rt->R - rt->L);
+    if (d / measure(rt) > alpha) {
+      STATS_COUNT(COUNTER_APPROXIMATIONS, 1);
+      return diff.unit() / d * (rt.R - rt.L);
+    }
 
-    return getRepulsive(rt->ch[0], orig) + getRepulsive(rt->ch[1], orig);
+    return getRepulsive(rt.ch[0], orig) + getRepulsive(rt.ch[1], orig);
   }
 
-  T alpha;
-  Node* root;
-  vector<Vector<T, Dim>> coords;
-  size_t node_size_threashold;
+  vector<int> idx; // pts[i] = coords[idx[i]]
+  vector<Vector<T, Dim>> pts;
+  vector<Node> nodes;
 };
 
-#endif /* end of include guard:  */
+#endif /* end of include guard: KDTREE_HH */
@@ -0,0 +1,23 @@
+#ifndef LINLOG_HH
+#define LINLOG_HH
+
+#include "SpringElectrical.hh"
+
+// Noack's LinLog energy model: edge energy linear in the length and
+// logarithmic repulsion, i.e. a constant pull k along every edge and
+// repulsion k^2 / d. Densely connected groups draw together and apart from
+// the rest more clearly than with Fruchterman-Reingold.
+struct LinLogForces
+{
+  template<typename T>
+  T repulsion(T k, T c, int) const { return k * k * c; }
+  template<typename T, size_t Dim>
+  Vector<T, Dim> attraction(const Vector<T, Dim>& dist, T k, T c, int) const {
+    return dist.unit() * (k * c);
+  }
+};
+
+template<typename T, size_t Dim>
+using LinLog = SpringElectrical<T, Dim, LinLogForces>;
+
+#endif /* end of include guard: LINLOG_HH */
@@ -1,81 +1,335 @@
+#include <memory>
 #include "Core.hh"
 #include "Circle.hh"
 #include "FruchtermanReingold.hh"
 #include "Walshaw.hh"
+#include "LinLog.hh"
+#include "ForceAtlas2.hh"
+#include "MultilevelWalshaw.hh"
 #include "KamadaKawai.hh"
+#include "StressMajorization.hh"
+#include "Relayout.hh"
+#include "Components.hh"
+#include "Control.hh"
+#include "Embedding.hh"
+#include "Input.hh"
+#include "Output.hh"
 #include "Cmdline.h"
 
-int main(int argc, char* argv[])
+template<typename T, size_t Dim>
+static void setRepulsion(Repulsion<T, Dim>& rep, const gengetopt_args_info& args_info)
 {
-  gengetopt_args_info args_info;
-  if (cmdline_parser(argc, argv, &args_info) != 0)
+  if (! strcmp(args_info.repulsion_arg, "exact") || args_info.kd_arg == 0)
+    rep.method = REPULSION_EXACT;
+  else if (! strcmp(args_info.repulsion_arg, "fmm"))
+    rep.method = REPULSION_FMM;
+  else if (! strcmp(args_info.repulsion_arg, "morton"))
+    rep.method = REPULSION_MORTON;
+  else if (! strcmp(args_info.repulsion_arg, "grid"))
+    rep.method = REPULSION_GRID;
+  else
+    rep.method = REPULSION_KDTREE;
+  rep.alpha = args_info.alpha_arg;
+  rep.order = args_info.fmm_order_arg;
+}
+
+template<typename T>
+static void setCooling(Cooling<T>& cooling, const gengetopt_args_info& args_info)
+{
+  cooling.schedule = ! strcmp(args_info.cooling_arg, "adaptive") ? COOLING_ADAPTIVE : COOLING_LINEAR;
+  cooling.tolerance = args_info.convergence_arg;
+}
+
+template<typename T, size_t Dim, typename Forces>
+static void setSpringElectrical(SpringElectrical<T, Dim, Forces>& a, const gengetopt_args_info& args_info)
+{
+  a.iterations = args_info.iterations_arg;
+  a.separation_constant = args_info.separation_arg;
+  a.force_constant = args_info.repulsive_arg;
+  setRepulsion(a.repulsion, args_info);
+  setCooling(a.cooling, args_info);
+}
+
+// the initial layout named by --init
+template<typename T, size_t Dim>
+static ForceDirectedDrawing<T, Dim>* makeInitial(const array<T, Dim>& space, const gengetopt_args_info& args_info)
+{
+  if (! strcmp(args_info.init_arg, "hde")) {
+    auto a = new HighDimensionalEmbedding<T, Dim>(space);
+    a->pivots = args_info.init_size_arg;
+    return a;
+  }
+  if (! strcmp(args_info.init_arg, "spectral")) {
+    auto a = new Spectral<T, Dim>(space);
+    a->steps = args_info.init_size_arg;
+    return a;
+  }
+  return new Circle<T, Dim>(space);
+}
+
+// Lays out every graph of `in' on `workers' threads, each with its own copy
+// of `algo' starting from its own copy of `initial', or from nothing if
+// `initial' is NULL as algo makes its own start, and writes the layouts
+// in input order. Graphs are taken a chunk at a time so that memory stays
+// bounded. Each graph has `deadline' milliseconds if not negative.
+template<typename T, size_t Dim>
+static int layoutBatch(const ForceDirectedDrawing<T, Dim>& algo, const ForceDirectedDrawing<T, Dim>* initial, int workers, int deadline, GraphStream& in, const char* output, OutputFormat format)
+{
+  FILE* f = output ? fopen(output, "wb") : stdout;
+  if (! f) {
+    perror(output);
+    return 1;
+  }
+  const int chunk = 1024;
+  workers = max(workers, 1);
+  vector<std::unique_ptr<ForceDirectedDrawing<T, Dim>>> engines(workers), initials(workers);
+  vector<LayoutControl<T, Dim>> controls(workers);
+  for (int w = 0; w < workers; w++) {
+    engines[w].reset(algo.clone());
+    engines[w]->threads = 1;
+    if (initial) {
+      initials[w].reset(initial->clone());
+      initials[w]->threads = 1;
+    }
+    if (deadline >= 0)
+      engines[w]->control = &controls[w];
+  }
+  vector<Graph<T>> graphs(chunk, Graph<T>(0));
+  vector<vector<Vector<T, Dim>>> layouts(chunk);
+  bool ok = true;
+  long done = 0;
+  {
+    OutputBuffer out(f);
+    for (bool more = true; more; ) {
+      int count = 0;
+      while (count < chunk && (more = in.next(graphs[count])))
+        count++;
+      std::atomic<int> next(0);
+      parallelRun(min(workers, count), [&](int w) {
+        ForceDirectedDrawing<T, Dim>& e = *engines[w];
+        for (int i; (i = next++) < count; ) {
+          if (deadline >= 0)
+            controls[w].deadline = LayoutControl<T, Dim>::Clock::now() + std::chrono::milliseconds(deadline);
+          layouts[i].resize(graphs[i].n);
+          if (initials[w])
+            (*initials[w])(graphs[i], layouts[i]);
+          e(graphs[i], layouts[i]);
+        }
+      });
+      for (int i = 0; i < count; i++)
+        writeLayout(out, format, graphs[i], layouts[i], algo.space);
+      done += count;
+    }
+    ok = out.flush();
+  }
+  if (output)
+    ok &= fclose(f) == 0;
+  if (! ok) {
+    perror(output ? output : "stdout");
     return 1;
+  }
+  if (in.error) {
+    fprintf(stderr, "graph %ld: malformed\n", done + 1);
+    return 2;
+  }
+  return 0;
+}
 
+// The layout in T coordinates of Dim dimensions
+template<typename T, size_t Dim>
+static int run(const gengetopt_args_info& args_info)
+{
   bool use_w = false;
-  ForceDirectedDrawing<double, 2>* algo = NULL;
-  array<double, 2> space;
+  ForceDirectedDrawing<T, Dim>* algo = NULL;
+  array<T, Dim> space;
+  const double size[] = {args_info.x_arg, args_info.y_arg, args_info.z_arg};
+  for (size_t dim = 0; dim < Dim; dim++)
+    space[dim] = T(size[dim]);
   switch (args_info.algorithm_arg) {
   case 0:
     {
-      space[0] = args_info.x_arg;
-      space[1] = args_info.y_arg;
-      auto a = new FruchtermanReingold<double, 2>(space);
-      a->iterations = args_info.iterations_arg;
-      a->separation_constant = args_info.separation_arg;
-      a->force_constant = args_info.repulsive_arg;
-      if (a->use_BSP = args_info.kd_arg != 0)
-        a->alpha = args_info.alpha_arg;
+      auto a = new FruchtermanReingold<T, Dim>(space);
+      setSpringElectrical(*a, args_info);
       algo = a;
     }
     break;
   case 1:
     {
-      space[0] = args_info.x_arg;
-      space[1] = args_info.y_arg;
-      auto a = new Walshaw<double, 2>(space);
-      a->iterations = args_info.iterations_arg;
-      a->separation_constant = args_info.separation_arg;
-      a->force_constant = args_info.repulsive_arg;
-      if (a->use_BSP = args_info.kd_arg != 0)
-        a->alpha = args_info.alpha_arg;
+      auto a = new Walshaw<T, Dim>(space);
+      setSpringElectrical(*a, args_info);
       algo = a;
     }
     break;
   case 2:
     {
-      space[0] = args_info.x_arg;
-      space[1] = args_info.y_arg;
-      auto a = new KamadaKawai<double, 2>(space);
+      auto a = new KamadaKawai<T, Dim>(space);
+      if (! strcmp(args_info.distances_arg, "float"))
+        a->storage = KamadaKawai<T, Dim>::STORAGE_FLOAT;
+      else if (! strcmp(args_info.distances_arg, "hops"))
+        a->storage = KamadaKawai<T, Dim>::STORAGE_HOPS;
+      if (args_info.distances_file_given)
+        a->distance_file = args_info.distances_file_arg;
       algo = a;
       use_w = true;
     }
     break;
+  case 3:
+    {
+      auto a = new MultilevelWalshaw<T, Dim>(space);
+      setSpringElectrical(*a, args_info);
+      a->coarsening_ratio = args_info.coarsening_ratio_arg;
+      a->min_level_size = args_info.min_level_size_arg;
+      algo = a;
+    }
+    break;
+  case 4:
+    {
+      auto a = new StressMajorization<T, Dim>(space);
+      a->iterations = args_info.iterations_arg;
+      a->pivots = args_info.pivots_arg;
+      algo = a;
+      use_w = true;
+    }
+    break;
+  case 5:
+    {
+      auto a = new LinLog<T, Dim>(space);
+      setSpringElectrical(*a, args_info);
+      algo = a;
+    }
+    break;
+  case 6:
+    {
+      auto a = new ForceAtlas2<T, Dim>(space);
+      setSpringElectrical(*a, args_info);
+      algo = a;
+    }
+    break;
   default:
     return 2;
   }
+  std::unique_ptr<ForceDirectedDrawing<T, Dim>> initial(makeInitial(space, args_info));
+  initial->threads = args_info.threads_arg;
+  // a distance file cannot be shared by components laid out at once; packed
+  // components make their own start
+  bool pack = ! strcmp(args_info.components_arg, "pack") && ! args_info.distances_file_given;
+  if (pack)
+    algo = new ComponentLayout<T, Dim>(algo, initial->clone());
+  algo->threads = args_info.threads_arg;
 
-  int n, m;
-  if (scanf("%d%d", &n, &m) != 2)
-    return 2;
-  Graph<double> g(n);
-  while (m--) {
-    int u, v;
-    double w = 1;
-    if (scanf("%d%d", &u, &v) != 2 || ! (0 <= u && u < n && 0 <= v && v < n))
+  InputFormat input_format = ! strcmp(args_info.input_format_arg, "binary") ? INPUT_BINARY : INPUT_TEXT;
+  OutputFormat format = OUTPUT_TEXT;
+  if (! strcmp(args_info.output_format_arg, "svg"))
+    format = OUTPUT_SVG;
+  else if (! strcmp(args_info.output_format_arg, "binary"))
+    format = OUTPUT_BINARY;
+  else if (! strcmp(args_info.output_format_arg, "binary-float"))
+    format = OUTPUT_BINARY_FLOAT;
+
+  if (args_info.batch_given) {
+    if (args_info.initial_given || args_info.distances_file_given || args_info.stats_given) {
+      fprintf(stderr, "--batch: --initial, --distances-file and --stats take a single graph\n");
+      return 1;
+    }
+    GraphStream in(input_format, use_w);
+    if (! in.open(args_info.input_arg)) {
+      perror(args_info.input_arg ? args_info.input_arg : "stdin");
       return 2;
-    if (use_w)
-      if (scanf("%lf", &w) != 1 || ! (0 <= w))
-        return 2;
-    g.addEdge(u, v, w);
+    }
+    int r = layoutBatch(*algo, pack ? NULL : initial.get(), args_info.threads_arg, args_info.deadline_given ? args_info.deadline_arg : -1, in, args_info.output_arg, format);
+    delete algo;
+    return r;
   }
 
-  vector<Vector<double, 2>> pos(n);
-  Circle<double, 2> circle(space);
-  circle(g, pos);
+  Graph<T> g(0);
+  if (! readGraph(args_info.input_arg, input_format, use_w, g)) {
+    if (errno)
+      perror(args_info.input_arg ? args_info.input_arg : "stdin");
+    return 2;
+  }
+  int n = g.n;
+
+  vector<Vector<T, Dim>> pos(n);
+  LayoutControl<T, Dim> control;
+  if (args_info.deadline_given) {
+    control.deadline = LayoutControl<T, Dim>::Clock::now() + std::chrono::milliseconds(args_info.deadline_arg);
+    algo->control = &control;
+  }
+  if (args_info.initial_given) {
+    vector<Vector<T, Dim>> prior;
+    if (! readLayout(args_info.initial_arg, prior)) {
+      if (errno)
+        perror(args_info.initial_arg);
+      else
+        fprintf(stderr, "%s: not a %dD layout\n", args_info.initial_arg, int(Dim));
+      return 2;
+    }
+    int known = min(int(prior.size()), n);
+    std::copy(prior.begin(), prior.begin() + known, pos.begin());
+    placeNewVertices(g, pos, known, space);
+    algo->warm = true;
+    if (args_info.previous_given) {
+      Graph<T> before(0);
+      if (! readGraph(args_info.previous_arg, input_format, use_w, before)) {
+        if (errno)
+          perror(args_info.previous_arg);
+        return 2;
+      }
+      vector<int> changed = changedVertices(before, g);
+      // vertices without a prior position move freely too
+      for (int u = known; u < n; u++)
+        changed.push_back(u);
+      algo->mobilities = relayoutMobility(g, changed, args_info.radius_arg, T(args_info.damping_arg));
+    }
+  } else if (! pack)
+    (*initial)(g, pos);
   (*algo)(g, pos);
+  if (algo->error) {
+    // only a distance file fails
+    errno = algo->error;
+    perror(args_info.distances_file_arg);
+    delete algo;
+    return 2;
+  }
+  if (args_info.verbose_given)
+    fprintf(stderr, "%d iterations%s\n", algo->iterations_run, algo->interrupted ? ", stopped at the deadline" : "");
+#ifdef ENABLE_STATS
+  if (args_info.stats_given)
+    Stats::global().writeJSON(stderr);
+#endif
   delete algo;
-  for (int u = 0; u < n; u++)
-    printf("%.2lf %.2lf\n", pos[u][0], pos[u][1]);
+  if (! writeLayout(args_info.output_arg, format, g, pos, space)) {
+    perror(args_info.output_arg ? args_info.output_arg : "stdout");
+    return 1;
+  }
+
+  return 0;
+}
+
+int main(int argc, char* argv[])
+{
+  gengetopt_args_info args_info;
+  if (cmdline_parser(argc, argv, &args_info) != 0)
+    return 1;
+#ifndef ENABLE_STATS
+  if (args_info.stats_given) {
+    fprintf(stderr, "--stats: built without ./configure --enable-stats\n");
+    return 1;
+  }
+#endif
 
+#ifdef USE_FLOAT
+  bool single = true;
+#else
+  bool single = false;
+#endif
+  if (args_info.precision_given)
+    single = ! strcmp(args_info.precision_arg, "float");
+  int r;
+  if (args_info.dim_arg == 3)
+    r = single ? run<float, 3>(args_info) : run<double, 3>(args_info);
+  else
+    r = single ? run<float, 2>(args_info) : run<double, 2>(args_info);
   cmdline_parser_free(&args_info);
+  return r;
 }
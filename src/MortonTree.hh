@@ -0,0 +1,366 @@
+#ifndef MORTONTREE_HH
+#define MORTONTREE_HH
+
+#include <stdint.h>
+#include <vector>
+#include "Core.hh"
+#include "Parallel.hh"
+
+// Barnes-Hut quadtree (octree in 3D) over Morton codes. Points are
+// radix-sorted by the Z-order code of their cell, so that every subtree is a
+// contiguous run of the sorted points; nodes are emitted in preorder and the
+// top-level subtrees are built concurrently. Traversal needs no stack: a node
+// records the first node after its subtree.
+//
+// order() is the permutation of the points into Morton order, for callers
+// that want to renumber their vertices to match (see VertexOrder).
+template<typename T, size_t Dim>
+class MortonTree
+{
+public:
+  MortonTree(T alpha = 1.5)
+    : alpha(alpha)
+      , leaf_size(8)
+      , threads(1) {}
+  struct Node {
+    Cube<T, Dim> bounding; // minimum bounding box
+    Vector<T, Dim> sum; // sum of coordinates in subtree
+    int L, R; // pts[L..R)
+    int skip; // next node in preorder outside the subtree
+    bool leaf;
+  };
+  void build(const vector<Vector<T, Dim>>& coords) {
+    int n = coords.size();
+    nodes.clear();
+    idx.resize(n);
+    pts.resize(n);
+    if (n == 0) return;
+    encode(coords);
+    sort();
+    parallelFor(threads, n, [&](int i) { pts[i] = coords[idx[i]]; });
+    emitTop();
+  }
+  // pts[i] = coords[order()[i]]
+  const vector<int>& order() const { return idx; }
+  Vector<T, Dim> getRepulsive(const Vector<T, Dim>& orig) const {
+    Vector<T, Dim> res;
+    res.fill(0);
+    for (size_t i = 0; i < nodes.size(); ) {
+      const Node& rt = nodes[i];
+      STATS_COUNT(COUNTER_NODES_VISITED, 1);
+      if (rt.leaf) {
+        STATS_COUNT(COUNTER_LEAF_PAIRS, rt.R - rt.L);
+        for (int j = rt.L; j < rt.R; j++)
+          if (orig != pts[j]) { // exclude itself
+            Vector<T, Dim> diff = orig - pts[j];
+            res += diff.unit() / diff.norm();
+          }
+        i = rt.skip;
+        continue;
+      }
+      // approximate
+      Vector<T, Dim> barycenter = rt.sum / (rt.R - rt.L);
+      auto diff = orig - barycenter;
+      T d = diff.norm();
+      if (d / measure(rt) > alpha) {
+        STATS_COUNT(COUNTER_APPROXIMATIONS, 1);
+        res += diff.unit() / d * (rt.R - rt.L);
+        i = rt.skip;
+      } else
+        i++;
+    }
+    return res;
+  }
+
+  T alpha;
+  int leaf_size, threads;
+protected:
+  // bits of each coordinate in a code
+  static const int bits = 63 / Dim < 32 ? 63 / Dim : 32;
+
+  void encode(const vector<Vector<T, Dim>>& coords) {
+    int n = coords.size();
+    array<T, Dim> lo, scale;
+    for (size_t dim = 0; dim < Dim; dim++) {
+      T mn = coords[0][dim], mx = coords[0][dim];
+      for (auto& x : coords) {
+        mn = min(mn, x[dim]);
+        mx = max(mx, x[dim]);
+      }
+      lo[dim] = mn;
+      scale[dim] = mx > mn ? T(uint64_t(1) << bits) / (mx - mn) : T(0);
+    }
+    code.resize(n);
+    parallelFor(threads, n, [&](int u) {
+      uint64_t c = 0;
+      uint32_t q[Dim];
+      for (size_t dim = 0; dim < Dim; dim++)
+        q[dim] = uint32_t(min(T((uint64_t(1) << bits) - 1), (coords[u][dim] - lo[dim]) * scale[dim]));
+      for (int b = bits; b-- > 0; )
+        for (size_t dim = 0; dim < Dim; dim++)
+          c = c << 1 | (q[dim] >> b & 1);
+      code[u] = c;
+      idx[u] = u;
+    });
+  }
+
+  // LSD radix sort of (code, idx) by bytes. Each block of the input counts
+  // its digits and scatters its own elements, blocks in parallel; digits that
+  // all codes share are skipped.
+  void sort() {
+    int n = code.size();
+    int blocks = threads > 1 ? max(1, min(4 * threads, n / 4096)) : 1;
+    count.resize(blocks);
+    code2.resize(n);
+    idx2.resize(n);
+    for (int shift = 0; shift < bits * int(Dim); shift += 8) {
+      parallelFor(threads, blocks, [&](int b) {
+        count[b].fill(0);
+        for (int i = int(int64_t(n) * b / blocks); i < int(int64_t(n) * (b + 1) / blocks); i++)
+          count[b][code[i] >> shift & 255]++;
+      }, 1);
+      bool shared = false;
+      for (int d = 0; d < 256 && ! shared; d++) {
+        int total = 0;
+        for (int b = 0; b < blocks; b++)
+          total += count[b][d];
+        shared = total == n;
+      }
+      if (shared) continue;
+      int sum = 0;
+      for (int d = 0; d < 256; d++)
+        for (int b = 0; b < blocks; b++) {
+          int c = count[b][d];
+          count[b][d] = sum;
+          sum += c;
+        }
+      parallelFor(threads, blocks, [&](int b) {
+        for (int i = int(int64_t(n) * b / blocks); i < int(int64_t(n) * (b + 1) / blocks); i++) {
+          int j = count[b][code[i] >> shift & 255]++;
+          code2[j] = code[i];
+          idx2[j] = idx[i];
+        }
+      }, 1);
+      code.swap(code2);
+      idx.swap(idx2);
+    }
+  }
+
+  // child ranges of the cell at `level' over pts[L..R): ch[c..c+1) for the
+  // 2^Dim children in Z-order. Levels in which every point falls into the
+  // same child are skipped, so a node has at least two children. Returns the
+  // level of the children.
+  int children(int L, int R, int level, int ch[]) const {
+    for (; level < bits; level++) {
+      int shift = (bits - level - 1) * Dim, nonempty = 0;
+      ch[0] = L;
+      for (int c = 0; c < (1 << Dim); c++) {
+        ch[c + 1] = std::partition_point(code.begin() + ch[c], code.begin() + R,
+            [&](uint64_t x) { return int(x >> shift & ((1 << Dim) - 1)) <= c; }) - code.begin();
+        nonempty += ch[c] < ch[c + 1];
+      }
+      if (nonempty > 1)
+        return level + 1;
+    }
+    return bits;
+  }
+  bool isLeaf(int L, int R, int level) const {
+    return R - L <= leaf_size || level >= bits || code[L] == code[R - 1];
+  }
+
+  // Append the subtree over pts[L..R) to `out'
+  void emit(int L, int R, int level, vector<Node>& out) const {
+    int rt = out.size();
+    out.push_back(Node());
+    out[rt].L = L;
+    out[rt].R = R;
+    out[rt].leaf = isLeaf(L, R, level);
+    if (out[rt].leaf)
+      fitLeaf(out[rt]);
+    else {
+      int ch[(1 << Dim) + 1];
+      int next = children(L, R, level, ch);
+      bool first = true;
+      for (int c = 0; c < (1 << Dim); c++)
+        if (ch[c] < ch[c + 1]) {
+          int i = out.size();
+          emit(ch[c], ch[c + 1], next, out);
+          merge(out[rt], out[i], first);
+          first = false;
+        }
+    }
+    out[rt].skip = out.size();
+  }
+
+  // The subtrees `split' levels below the root are emitted by different
+  // threads into their own arrays, then spliced in preorder.
+  void emitTop() {
+    int split = 0;
+    while (threads > 1 && (1 << (Dim * split)) < 4 * threads)
+      split++;
+    tasks.clear();
+    cut(0, pts.size(), 0, split, tasks);
+    if (parts.size() < tasks.size())
+      parts.resize(tasks.size());
+    for (auto& part : parts)
+      part.clear();
+    parallelFor(threads, tasks.size(), [&](int t) {
+      emit(tasks[t][0], tasks[t][1], tasks[t][2], parts[t]);
+    }, 1);
+    size_t t = 0;
+    splice(0, pts.size(), 0, split, parts, t);
+  }
+  // subtrees at depth `split', in preorder, as (L, R, level)
+  void cut(int L, int R, int level, int split, vector<array<int, 3>>& tasks) const {
+    if (split == 0 || isLeaf(L, R, level)) {
+      tasks.push_back(array<int, 3>{{L, R, level}});
+      return;
+    }
+    int ch[(1 << Dim) + 1];
+    int next = children(L, R, level, ch);
+    for (int c = 0; c < (1 << Dim); c++)
+      if (ch[c] < ch[c + 1])
+        cut(ch[c], ch[c + 1], next, split - 1, tasks);
+  }
+  // emit the nodes above the cut, parts[t...] below it
+  void splice(int L, int R, int level, int split, vector<vector<Node>>& parts, size_t& t) {
+    if (split == 0 || isLeaf(L, R, level)) {
+      int base = nodes.size();
+      for (auto& x : parts[t]) {
+        nodes.push_back(x);
+        nodes.back().skip += base;
+      }
+      t++;
+      return;
+    }
+    int rt = nodes.size();
+    nodes.push_back(Node());
+    nodes[rt].L = L;
+    nodes[rt].R = R;
+    nodes[rt].leaf = false;
+    int ch[(1 << Dim) + 1];
+    int next = children(L, R, level, ch);
+    bool first = true;
+    for (int c = 0; c < (1 << Dim); c++)
+      if (ch[c] < ch[c + 1]) {
+        int i = nodes.size();
+        splice(ch[c], ch[c + 1], next, split - 1, parts, t);
+        merge(nodes[rt], nodes[i], first);
+        first = false;
+      }
+    nodes[rt].skip = nodes.size();
+  }
+
+  void fitLeaf(Node& rt) const {
+    rt.sum.fill(0);
+    rt.bounding.lo = rt.bounding.hi = pts[rt.L];
+    for (int j = rt.L; j < rt.R; j++) {
+      rt.sum += pts[j];
+      for (size_t dim = 0; dim < Dim; dim++) {
+        rt.bounding.lo[dim] = min(rt.bounding.lo[dim], pts[j][dim]);
+        rt.bounding.hi[dim] = max(rt.bounding.hi[dim], pts[j][dim]);
+      }
+    }
+  }
+  static void merge(Node& rt, const Node& ch, bool first) {
+    if (first) {
+      rt.sum = ch.sum;
+      rt.bounding = ch.bounding;
+      return;
+    }
+    rt.sum += ch.sum;
+    for (size_t dim = 0; dim < Dim; dim++) {
+      rt.bounding.lo[dim] = min(rt.bounding.lo[dim], ch.bounding.lo[dim]);
+      rt.bounding.hi[dim] = max(rt.bounding.hi[dim], ch.bounding.hi[dim]);
+    }
+  }
+  static T measure(const Node& rt) {
+    T res(0);
+    for (size_t dim = 0; dim < Dim; dim++)
+      res = max(res, rt.bounding.hi[dim] - rt.bounding.lo[dim]);
+    return res;
+  }
+
+  vector<uint64_t> code; // code[i]: Morton code of pts[i]
+  vector<int> idx; // pts[i] = coords[idx[i]]
+  vector<Vector<T, Dim>> pts;
+  vector<Node> nodes;
+  // scratch of sort() and emitTop(), kept between builds
+  vector<array<int, 256>> count;
+  vector<uint64_t> code2;
+  vector<int> idx2;
+  vector<array<int, 3>> tasks;
+  vector<vector<Node>> parts;
+};
+
+// A layout's graph and positions renumbered by successive permutations, so
+// that vertices close in the plane are close in memory, and the way back to
+// the caller's numbering.
+template<typename T, size_t Dim>
+class VertexOrder
+{
+public:
+  VertexOrder() : cur(NULL), graph(0), scratch(0) {}
+  void reset(const Graph<T>& g) {
+    cur = &g;
+    label.clear();
+  }
+  // the graph in the current numbering
+  const Graph<T>& get() const { return *cur; }
+  // vertex order[i] becomes i
+  void apply(const vector<int>& order, vector<Vector<T, Dim>>& pos, int threads) {
+    const Graph<T>& g = *cur;
+    int n = g.n;
+    if (label.empty()) {
+      label.resize(n);
+      for (int i = 0; i < n; i++)
+        label[i] = i;
+    }
+    rank.resize(n);
+    for (int i = 0; i < n; i++)
+      rank[order[i]] = i;
+    Graph<T>& h = cur == &graph ? scratch : graph;
+    h.n = n;
+    h.offset.resize(n + 1);
+    h.offset[0] = 0;
+    for (int i = 0; i < n; i++)
+      h.offset[i + 1] = h.offset[i] + g.degree(order[i]);
+    h.adj.resize(g.adj.size());
+    h.weight.resize(g.weight.size());
+    moved.resize(n);
+    relabeled.resize(n);
+    parallelFor(threads, n, [&](int i) {
+      int u = order[i];
+      for (int j = g.offset[u], k = h.offset[i]; j < g.offset[u + 1]; j++, k++) {
+        h.adj[k] = rank[g.adj[j]];
+        h.weight[k] = g.weight[j];
+      }
+      moved[i] = pos[u];
+      relabeled[i] = label[u];
+    });
+    pos.swap(moved);
+    label.swap(relabeled);
+    cur = &h;
+  }
+  // number in the graph given to reset() of vertex i
+  int original(int i) const { return label.empty() ? i : label[i]; }
+  // original numbers of all vertices, NULL while not renumbered
+  const vector<int>* labels() const { return label.empty() ? NULL : &label; }
+  // positions back in the numbering of the graph given to reset()
+  void restore(vector<Vector<T, Dim>>& pos) {
+    if (label.empty()) return;
+    moved.resize(pos.size());
+    for (size_t i = 0; i < pos.size(); i++)
+      moved[label[i]] = pos[i];
+    pos.swap(moved);
+    label.clear();
+  }
+
+protected:
+  const Graph<T>* cur;
+  Graph<T> graph, scratch;
+  vector<int> label, rank, relabeled; // label[i]: original number of vertex i
+  vector<Vector<T, Dim>> moved;
+};
+
+#endif /* end of include guard: MORTONTREE_HH */
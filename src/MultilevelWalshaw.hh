@@ -0,0 +1,169 @@
+#ifndef MULTILEVELWALSHAW_HH
+#define MULTILEVELWALSHAW_HH
+
+#include <cmath>
+#include "Core.hh"
+#include "Circle.hh"
+#include "Walshaw.hh"
+
+// Scratch of coarsen(), for callers that keep it between calls
+struct CoarsenBuffers
+{
+  vector<int> order, first, members, slot;
+};
+
+// Contract a maximal matching of `g' into `coarse'. parent[u] receives the coarse vertex containing u.
+// Vertices are visited by increasing degree and matched along their heaviest edge.
+template<typename T>
+void coarsen(const Graph<T>& g, vector<int>& parent, Graph<T>& coarse, CoarsenBuffers& buf)
+{
+  // counting sort by degree, stable
+  vector<int> &order = buf.order, &first = buf.first, &members = buf.members, &slot = buf.slot;
+  int top = 0;
+  for (int u = 0; u < g.n; u++)
+    top = max(top, g.degree(u));
+  first.assign(top + 2, 0);
+  for (int u = 0; u < g.n; u++)
+    first[g.degree(u) + 1]++;
+  for (int d = 0; d <= top; d++)
+    first[d + 1] += first[d];
+  order.resize(g.n);
+  for (int u = 0; u < g.n; u++)
+    order[first[g.degree(u)]++] = u;
+
+  int n = 0;
+  parent.assign(g.n, -1);
+  for (int u : order)
+    if (parent[u] < 0) {
+      int mate = -1;
+      for (int j = g.offset[u]; j < g.offset[u + 1]; j++)
+        if (g.adj[j] != u && parent[g.adj[j]] < 0 && (mate < 0 || g.weight[j] > g.weight[mate]))
+          mate = j;
+      parent[u] = n;
+      if (mate >= 0)
+        parent[g.adj[mate]] = n;
+      n++;
+    }
+
+  // members[first[c]..first[c+1]) are the fine vertices of coarse vertex c;
+  // first[c] is the fill pointer of c until shifted back
+  first.assign(n + 1, 0);
+  members.resize(g.n);
+  for (int u = 0; u < g.n; u++)
+    first[parent[u] + 1]++;
+  for (int c = 0; c < n; c++)
+    first[c + 1] += first[c];
+  for (int u = 0; u < g.n; u++)
+    members[first[parent[u]]++] = u;
+  for (int c = n; c > 0; c--)
+    first[c] = first[c - 1];
+  first[0] = 0;
+
+  // coarse vertices are emitted in order, so their arcs go straight into CSR
+  coarse.n = n;
+  coarse.offset.resize(n + 1);
+  coarse.adj.clear();
+  coarse.weight.clear();
+  slot.assign(n, -1);
+  for (int c = 0; c < n; c++) {
+    coarse.offset[c] = coarse.adj.size();
+    for (int i = first[c]; i < first[c + 1]; i++) {
+      int u = members[i];
+      for (int j = g.offset[u]; j < g.offset[u + 1]; j++) {
+        int d = parent[g.adj[j]];
+        if (d == c) continue;
+        if (slot[d] < 0) {
+          slot[d] = coarse.adj.size();
+          coarse.adj.push_back(d);
+          coarse.weight.push_back(T(0));
+        }
+        coarse.weight[slot[d]] += g.weight[j];
+      }
+    }
+    for (int j = coarse.offset[c]; j < int(coarse.adj.size()); j++)
+      slot[coarse.adj[j]] = -1;
+  }
+  coarse.offset[n] = coarse.adj.size();
+}
+
+template<typename T, size_t Dim>
+struct MultilevelWalshaw : Walshaw<T, Dim>
+{
+  using Walshaw<T, Dim>::space;
+  using Walshaw<T, Dim>::separation_constant;
+  using Walshaw<T, Dim>::iterations;
+  using Walshaw<T, Dim>::layout;
+
+  MultilevelWalshaw(const array<T, Dim>& space)
+    : Walshaw<T, Dim>(space)
+      , coarsening_ratio(0.75)
+      , min_level_size(10)
+      , refinement_iterations(10) {}
+  virtual MultilevelWalshaw* clone() const { return new MultilevelWalshaw(*this); }
+  virtual void operator()(const Graph<T>& g, vector<Vector<T, Dim>>& pos) {
+    // the coarse levels would discard a given layout; refine it directly
+    if (this->warm) {
+      Walshaw<T, Dim>::operator()(g, pos);
+      return;
+    }
+    // levels[l] is level l + 1, coarsened from level l, level 0 being `g'
+    // itself; the first `depth' are in use, the others kept for later calls
+    size_t depth = 0;
+    while ((depth ? levels[depth - 1] : g).n > min_level_size) {
+      if (levels.size() == depth) {
+        levels.emplace_back(0);
+        parent.emplace_back();
+      }
+      const Graph<T>& fine = depth ? levels[depth - 1] : g;
+      coarsen(fine, parent[depth], levels[depth], coarsening);
+      if (levels[depth].n > coarsening_ratio * fine.n)
+        break;
+      depth++;
+    }
+
+    // Walshaw: k shrinks by sqrt(4/7) on each uncoarsening step
+    T k = separation_constant * std::pow(accumulate(space.begin(), space.end(), T(1), std::multiplies<T>()) / T(g.n), T(1) / T(Dim));
+    T k_top = k * std::pow(std::sqrt(T(7) / T(4)), T(depth));
+
+    // copied rather than swapped with `pos', which keeps its own capacity
+    cur.resize(depth ? levels[depth - 1].n : g.n);
+    const Graph<T>& top = depth == 0 ? g : levels[depth - 1];
+    Circle<T, Dim> circle(space);
+    circle(top, cur);
+    this->iterations_run = 0;
+    this->interrupted = false;
+    // a layout stopped early still ends at the finest level, without passes
+    layout(top, cur, k_top, *std::min_element(space.begin(), space.end()), iterations, depth == 0);
+
+    for (int l = int(depth) - 1; l >= 0; l--) {
+      const Graph<T>& fine = l ? levels[l - 1] : g;
+      k = k_top * std::pow(std::sqrt(T(4) / T(7)), T(depth - l));
+      // place matched vertices on both sides of their parent
+      next.resize(fine.n);
+      seen.assign(cur.size(), 0);
+      for (int u = 0; u < fine.n; u++) {
+        int c = parent[l][u];
+        next[u] = cur[c];
+        next[u][c % Dim] += seen[c]++ ? k / 100 : - k / 100;
+      }
+      cur.swap(next);
+      layout(fine, cur, k, k, refinement_iterations, l == 0);
+    }
+    pos.assign(cur.begin(), cur.end());
+
+    normalizeToSpace(pos, space);
+  }
+
+  T coarsening_ratio;
+  int min_level_size, refinement_iterations;
+
+protected:
+  // kept between calls
+  vector<Graph<T>> levels;
+  vector<vector<int>> parent;
+  CoarsenBuffers coarsening;
+  vector<Vector<T, Dim>> cur, next;
+  vector<char> seen;
+};
+
+#endif /* end of include guard: MULTILEVELWALSHAW_HH */
@@ -0,0 +1,36 @@
+#include <cmath>
+#include "Output.hh"
+
+void OutputBuffer::integer(long x)
+{
+  char s[24], *p = s + sizeof s;
+  unsigned long u = x < 0 ? - (unsigned long)x : x;
+  do
+    *--p = '0' + u % 10;
+  while (u /= 10);
+  if (x < 0)
+    *--p = '-';
+  put(p, s + sizeof s - p);
+}
+
+// Rounds x * 100 to an integer. When that product is too close to a half for
+// its rounding error to be ruled out, printf decides.
+void OutputBuffer::fixed2(double x)
+{
+  double r = x * 100, fl = std::floor(r), frac = r - fl;
+  if (! (std::abs(x) < 1e9) || std::abs(frac - 0.5) < 1e-4) {
+    char s[320]; // enough for %.2f of any double
+    int n = snprintf(s, sizeof s, "%.2f", x);
+    put(s, n);
+    return;
+  }
+  long c = long(frac < 0.5 ? fl : fl + 1);
+  if (std::signbit(x))
+    put('-');
+  if (c < 0)
+    c = - c;
+  integer(c / 100);
+  put('.');
+  put(char('0' + c / 10 % 10));
+  put(char('0' + c % 10));
+}
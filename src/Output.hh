@@ -0,0 +1,159 @@
+#ifndef OUTPUT_HH
+#define OUTPUT_HH
+
+#include <stdint.h>
+#include <string.h>
+#include "Core.hh"
+
+enum OutputFormat { OUTPUT_TEXT, OUTPUT_SVG, OUTPUT_BINARY, OUTPUT_BINARY_FLOAT };
+
+// Large buffered writes to a stdio stream, with number formatting that does
+// not go through printf
+class OutputBuffer
+{
+public:
+  OutputBuffer(FILE* f) : f(f), len(0), error(false) {}
+  ~OutputBuffer() { flush(); }
+  void put(const char* s, size_t n) {
+    if (len + n > sizeof buf) {
+      flush();
+      if (n > sizeof buf) {
+        error |= fwrite(s, 1, n, f) != n;
+        return;
+      }
+    }
+    memcpy(buf + len, s, n);
+    len += n;
+  }
+  void put(const char* s) { put(s, strlen(s)); }
+  void put(char c) {
+    if (len == sizeof buf) flush();
+    buf[len++] = c;
+  }
+  void integer(long x);
+  // as printf("%.2f", x)
+  void fixed2(double x);
+  // false if anything failed to be written
+  bool flush() {
+    error |= fwrite(buf, 1, len, f) != len;
+    len = 0;
+    error |= fflush(f) != 0;
+    return ! error;
+  }
+
+protected:
+  FILE* f;
+  char buf[1 << 16];
+  size_t len;
+  bool error;
+};
+
+// Binary layout, in native byte order:
+//   BinaryLayoutHeader
+//   float or double x[n][dim]
+struct BinaryLayoutHeader
+{
+  char magic[4]; // "FDGL"
+  uint32_t dim;
+  uint32_t size; // bytes per coordinate, 4 or 8
+  uint32_t reserved;
+  uint64_t n;
+};
+
+// n lines of coordinates with two decimals, as the program always printed
+template<typename T, size_t Dim>
+void writeText(OutputBuffer& out, const vector<Vector<T, Dim>>& pos)
+{
+  for (auto& x : pos) {
+    for (size_t dim = 0; dim < Dim; dim++) {
+      if (dim) out.put(' ');
+      out.fixed2(x[dim]);
+    }
+    out.put('\n');
+  }
+}
+
+template<typename S, typename T, size_t Dim>
+void writeBinary(OutputBuffer& out, const vector<Vector<T, Dim>>& pos)
+{
+  BinaryLayoutHeader h = {{'F', 'D', 'G', 'L'}, uint32_t(Dim), uint32_t(sizeof(S)), 0, uint64_t(pos.size())};
+  out.put(reinterpret_cast<const char*>(&h), sizeof h);
+  S row[Dim];
+  for (auto& x : pos) {
+    for (size_t dim = 0; dim < Dim; dim++)
+      row[dim] = S(x[dim]);
+    out.put(reinterpret_cast<const char*>(row), sizeof row);
+  }
+}
+
+// Vertices as labelled dots and edges as lines over them, in a 20px margin
+// around `space'; the first two coordinates are drawn
+template<typename T, size_t Dim>
+void writeSVG(OutputBuffer& out, const Graph<T>& g, const vector<Vector<T, Dim>>& pos, const array<T, Dim>& space)
+{
+  static_assert(Dim >= 2, "SVG needs two coordinates");
+  out.put("<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\" width=\"");
+  out.integer(long(space[0]) + 40);
+  out.put("px\" height=\"");
+  out.integer(long(space[1]) + 40);
+  out.put("px\">\n");
+  for (int u = 0; u < g.n; u++) {
+    out.put("<circle cx=\"");
+    out.fixed2(pos[u][0] + 20);
+    out.put("\" cy=\"");
+    out.fixed2(pos[u][1] + 20);
+    out.put("\" r=\"5\" fill=\"black\"/>\n<text x=\"");
+    out.fixed2(pos[u][0] + 25);
+    out.put("\" y=\"");
+    out.fixed2(pos[u][1] + 20);
+    out.put("\" fill=\"red\">");
+    out.integer(u);
+    out.put("</text>\n");
+  }
+  for (int u = 0; u < g.n; u++)
+    for (int j = g.offset[u]; j < g.offset[u + 1]; j++)
+      if (u < g.adj[j]) {
+        int v = g.adj[j];
+        out.put("<line x1=\"");
+        out.fixed2(pos[u][0] + 20);
+        out.put("\" y1=\"");
+        out.fixed2(pos[u][1] + 20);
+        out.put("\" x2=\"");
+        out.fixed2(pos[v][0] + 20);
+        out.put("\" y2=\"");
+        out.fixed2(pos[v][1] + 20);
+        out.put("\" stroke=\"black\"/>\n");
+      }
+  out.put("</svg>\n");
+}
+
+template<typename T, size_t Dim>
+void writeLayout(OutputBuffer& out, OutputFormat format, const Graph<T>& g, const vector<Vector<T, Dim>>& pos, const array<T, Dim>& space)
+{
+  switch (format) {
+  case OUTPUT_SVG: writeSVG(out, g, pos, space); break;
+  case OUTPUT_BINARY: writeBinary<double>(out, pos); break;
+  case OUTPUT_BINARY_FLOAT: writeBinary<float>(out, pos); break;
+  default: writeText(out, pos);
+  }
+}
+
+// NULL writes stdout. False with errno set on failure.
+template<typename T, size_t Dim>
+bool writeLayout(const char* path, OutputFormat format, const Graph<T>& g, const vector<Vector<T, Dim>>& pos, const array<T, Dim>& space)
+{
+  FILE* f = path ? fopen(path, "wb") : stdout;
+  if (! f)
+    return false;
+  bool ok;
+  {
+    OutputBuffer out(f);
+    writeLayout(out, format, g, pos, space);
+    ok = out.flush();
+  }
+  if (path)
+    ok &= fclose(f) == 0;
+  return ok;
+}
+
+#endif /* end of include guard: OUTPUT_HH */
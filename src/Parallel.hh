@@ -0,0 +1,189 @@
+#ifndef PARALLEL_HH
+#define PARALLEL_HH
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "Core.hh"
+
+// Threads kept for the whole process, so that parallel passes start none
+// once enough have been made. A call takes idle workers, and makes more when
+// there are too few, so calls from several threads, or from within a job,
+// each get their own.
+class WorkerPool
+{
+public:
+  static WorkerPool& shared() {
+    static WorkerPool pool;
+    return pool;
+  }
+  ~WorkerPool() {
+    {
+      std::lock_guard<std::mutex> l(lock);
+      quit = true;
+      for (auto& w : workers)
+        w->wake.notify_one();
+    }
+    for (auto& w : workers)
+      w->thread.join();
+  }
+
+  // f(context, t) for t in [0, threads), t = 0 on the caller's thread; those
+  // no worker could be made for run there too, after it. Once all are done,
+  // throws what the caller's share threw, or else the first exception of a
+  // worker.
+  void run(int threads, void (*f)(void*, int), void* context) {
+    Job job;
+    job.f = f;
+    job.context = context;
+    int t = 1;
+    {
+      std::lock_guard<std::mutex> l(lock);
+      for (; t < threads; t++) {
+        if (idle.empty())
+          try {
+            // nothing may throw once the thread runs
+            workers.reserve(workers.size() + 1);
+            idle.reserve(workers.size() + 1);
+            std::unique_ptr<Worker> w(new Worker());
+            w->thread = std::thread(&WorkerPool::work, this, w.get());
+            workers.push_back(std::move(w));
+            idle.push_back(workers.back().get());
+          } catch (...) {
+            break;
+          }
+        Worker* w = idle.back();
+        idle.pop_back();
+        w->job = &job;
+        w->t = t;
+        w->wake.notify_one();
+      }
+      job.pending = t - 1;
+    }
+    try {
+      f(context, 0);
+      for (int u = t; u < threads; u++)
+        f(context, u);
+    } catch (...) {
+      wait(job);
+      throw;
+    }
+    wait(job);
+    if (job.error)
+      std::rethrow_exception(job.error);
+  }
+
+protected:
+  struct Job
+  {
+    void (*f)(void*, int);
+    void* context;
+    // workers still running it
+    int pending;
+    std::condition_variable done;
+    // the first exception a worker caught
+    std::exception_ptr error;
+  };
+  struct Worker
+  {
+    Worker() : job(NULL), t(0) {}
+    std::thread thread;
+    std::condition_variable wake;
+    Job* job;
+    int t;
+  };
+
+  WorkerPool() : quit(false) {}
+  void work(Worker* w) {
+    std::unique_lock<std::mutex> l(lock);
+    for (;;) {
+      while (! w->job && ! quit)
+        w->wake.wait(l);
+      if (! w->job)
+        return;
+      Job* job = w->job;
+      l.unlock();
+      std::exception_ptr error;
+      try {
+        job->f(job->context, w->t);
+      } catch (...) {
+        error = std::current_exception();
+      }
+      // the caller reads the counts once the job is done
+      STATS_FLUSH();
+      l.lock();
+      if (error && ! job->error)
+        job->error = error;
+      w->job = NULL;
+      idle.push_back(w);
+      if (--job->pending == 0)
+        job->done.notify_one();
+    }
+  }
+  void wait(Job& job) {
+    std::unique_lock<std::mutex> l(lock);
+    while (job.pending)
+      job.done.wait(l);
+  }
+
+  std::mutex lock;
+  vector<std::unique_ptr<Worker>> workers;
+  vector<Worker*> idle;
+  bool quit;
+};
+
+// Run f(t) for t in [0, threads) on as many threads, t = 0 on the caller's,
+// e.g. for workers that keep state between the items they take
+template<typename F>
+void parallelRun(int threads, F f)
+{
+  if (threads <= 1) {
+    f(0);
+    return;
+  }
+  WorkerPool::shared().run(threads, [](void* f, int t) { (*static_cast<F*>(f))(t); }, &f);
+}
+
+// Run f(i) for every i in [0, n) on `threads' threads. Indices are handed out
+// in chunks from a shared counter, so busy threads steal the remaining work.
+// f must only write state owned by i; the result then does not depend on
+// scheduling.
+template<typename F>
+void parallelFor(int threads, int n, F f, int chunk = 256)
+{
+  if (threads <= 1 || n <= chunk) {
+    for (int i = 0; i < n; i++)
+      f(i);
+    return;
+  }
+  std::atomic<int> next(0);
+  parallelRun(min(threads, (n + chunk - 1) / chunk), [&](int) {
+    for (int lo; (lo = next.fetch_add(chunk)) < n; ) {
+      int hi = min(n, lo + chunk);
+      for (int i = lo; i < hi; i++)
+        f(i);
+    }
+  });
+}
+
+// Run f and g concurrently if `fork' is set
+template<typename F, typename G>
+void parallelInvoke(bool fork, F f, G g)
+{
+  if (! fork) {
+    f();
+    g();
+    return;
+  }
+  parallelRun(2, [&](int t) {
+    if (t)
+      f();
+    else
+      g();
+  });
+}
+
+#endif /* end of include guard: PARALLEL_HH */
@@ -0,0 +1,120 @@
+#ifndef RELAYOUT_HH
+#define RELAYOUT_HH
+
+#include "Core.hh"
+
+// Relayout of a graph that changed since an earlier layout: positions for
+// the vertices that are new, and which vertices may move
+
+// Vertices [known, n) have no position yet. Breadth first from the placed
+// ones, each goes to the mean of its placed neighbours, nudged by a tenth of
+// the mean edge length so that new siblings do not coincide. Vertices no
+// placed one reaches go on a small circle around the centre of `space'.
+template<typename T, size_t Dim>
+void placeNewVertices(const Graph<T>& g, vector<Vector<T, Dim>>& pos, int known, const array<T, Dim>& space)
+{
+  T length = 0;
+  int edges = 0;
+  for (int u = 0; u < known; u++)
+    for (int j = g.offset[u]; j < g.offset[u + 1]; j++)
+      if (u < g.adj[j] && g.adj[j] < known) {
+        length += pos[u].dist(pos[g.adj[j]]);
+        edges++;
+      }
+  T nudge = (edges ? length / edges : *std::min_element(space.begin(), space.end()) / sqrt(T(max(g.n, 1)))) / 10;
+
+  vector<char> seen(g.n, 0);
+  vector<int> queue;
+  for (int u = 0; u < known; u++)
+    seen[u] = 1;
+  for (int u = known; u < g.n; u++)
+    for (int j = g.offset[u]; j < g.offset[u + 1]; j++)
+      if (g.adj[j] < known) {
+        seen[u] = 1;
+        queue.push_back(u);
+        break;
+      }
+  vector<char> placed(g.n, 0);
+  std::fill(placed.begin(), placed.begin() + known, 1);
+  for (size_t head = 0; head < queue.size(); head++) {
+    int u = queue[head], c = 0;
+    Vector<T, Dim> sum;
+    sum.fill(T(0));
+    for (int j = g.offset[u]; j < g.offset[u + 1]; j++) {
+      int v = g.adj[j];
+      if (placed[v]) {
+        sum += pos[v];
+        c++;
+      } else if (! seen[v]) {
+        seen[v] = 1;
+        queue.push_back(v);
+      }
+    }
+    // golden-angle directions, distinct for consecutive vertices
+    for (size_t dim = 0; dim < Dim; dim++)
+      pos[u][dim] = sum[dim] / c + nudge * std::cos(T(2.39996) * u + T(1.5708) * dim);
+    placed[u] = 1;
+  }
+
+  vector<int> rest;
+  for (int u = known; u < g.n; u++)
+    if (! placed[u])
+      rest.push_back(u);
+  for (size_t i = 0; i < rest.size(); i++) {
+    T angle = 2 * M_PI * i / rest.size();
+    for (size_t dim = 0; dim < Dim; dim++)
+      pos[rest[i]][dim] = space[dim] / 2;
+    pos[rest[i]][0] += space[0] / 4 * std::cos(angle);
+    if (Dim > 1)
+      pos[rest[i]][1 % Dim] += space[1 % Dim] / 4 * std::sin(angle);
+  }
+}
+
+// Vertices of `after' whose neighbours differ from those in `before',
+// including the vertices `before' does not have
+template<typename T>
+vector<int> changedVertices(const Graph<T>& before, const Graph<T>& after)
+{
+  vector<int> changed, a, b;
+  for (int u = 0; u < after.n; u++) {
+    if (u >= before.n) {
+      changed.push_back(u);
+      continue;
+    }
+    a.assign(before.adj.begin() + before.offset[u], before.adj.begin() + before.offset[u + 1]);
+    b.assign(after.adj.begin() + after.offset[u], after.adj.begin() + after.offset[u + 1]);
+    std::sort(a.begin(), a.end());
+    std::sort(b.begin(), b.end());
+    if (a != b)
+      changed.push_back(u);
+  }
+  return changed;
+}
+
+// 1 for vertices within `radius' hops of a changed one, `damping' for the
+// others
+template<typename T>
+vector<T> relayoutMobility(const Graph<T>& g, const vector<int>& changed, int radius, T damping)
+{
+  vector<int> hops(g.n, -1), queue;
+  for (int u : changed)
+    if (hops[u] < 0) {
+      hops[u] = 0;
+      queue.push_back(u);
+    }
+  for (size_t head = 0; head < queue.size(); head++) {
+    int u = queue[head];
+    if (hops[u] == radius) continue;
+    for (int j = g.offset[u]; j < g.offset[u + 1]; j++)
+      if (hops[g.adj[j]] < 0) {
+        hops[g.adj[j]] = hops[u] + 1;
+        queue.push_back(g.adj[j]);
+      }
+  }
+  vector<T> mobility(g.n);
+  for (int u = 0; u < g.n; u++)
+    mobility[u] = hops[u] >= 0 ? T(1) : damping;
+  return mobility;
+}
+
+#endif /* end of include guard: RELAYOUT_HH */
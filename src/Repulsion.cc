@@ -0,0 +1,138 @@
+#include <string.h>
+#include "Repulsion.hh"
+
+namespace {
+
+// v is processed in blocks that stay in L1 while every lane group of
+// [lo, hi) sweeps over them; per vertex the summation order is still v = 0..n-1.
+const int block = 1024;
+
+// One lane group holds W = sizeof(V) / sizeof(T) consecutive vertices u.
+// The law (x_u - x_v) / |x_u - x_v|^2 needs no square root, just one
+// reciprocal per pair; coincident points (including u itself) are masked.
+template<typename T, typename V, size_t Dim>
+inline __attribute__((always_inline))
+void kernel(const T* const x[], int n, int lo, int hi, T* const f[])
+{
+  const int W = sizeof(V) / sizeof(T);
+  for (int i = lo; i < hi; i++)
+    for (size_t dim = 0; dim < Dim; dim++)
+      f[dim][i] = 0;
+  for (int v0 = 0; v0 < n; v0 += block) {
+    int v1 = min(n, v0 + block);
+    for (int u0 = lo; u0 < hi; u0 += W) {
+      int w = min(W, hi - u0);
+      V xu[Dim], acc[Dim];
+      for (size_t dim = 0; dim < Dim; dim++) {
+        T buf[W] = {};
+        memcpy(buf, x[dim] + u0, w * sizeof(T));
+        memcpy(&xu[dim], buf, sizeof(V));
+        memcpy(buf, f[dim] + u0, w * sizeof(T));
+        memcpy(&acc[dim], buf, sizeof(V));
+      }
+      for (int v = v0; v < v1; v++) {
+        V diff[Dim], d2 = {};
+        for (size_t dim = 0; dim < Dim; dim++) {
+          diff[dim] = xu[dim] - x[dim][v];
+          d2 += diff[dim] * diff[dim];
+        }
+        V zero = {};
+        V inv = d2 > zero ? T(1) / d2 : zero;
+        for (size_t dim = 0; dim < Dim; dim++)
+          acc[dim] += diff[dim] * inv;
+      }
+      for (size_t dim = 0; dim < Dim; dim++) {
+        T buf[W];
+        memcpy(buf, &acc[dim], sizeof(V));
+        memcpy(f[dim] + u0, buf, w * sizeof(T));
+      }
+    }
+  }
+}
+
+template<typename T>
+struct Kernels
+{
+  typedef void (*Fn)(const T* const[], int, int, int, T* const[]);
+  Fn fn[4]; // indexed by dimension, 1 to 3
+  const char* name;
+};
+
+#define KERNELS(T, V, attr) \
+  attr void T##_##V##_1(const T* const x[], int n, int lo, int hi, T* const f[]) { kernel<T, V, 1>(x, n, lo, hi, f); } \
+  attr void T##_##V##_2(const T* const x[], int n, int lo, int hi, T* const f[]) { kernel<T, V, 2>(x, n, lo, hi, f); } \
+  attr void T##_##V##_3(const T* const x[], int n, int lo, int hi, T* const f[]) { kernel<T, V, 3>(x, n, lo, hi, f); }
+#define TABLE(T, V, name) { { NULL, T##_##V##_1, T##_##V##_2, T##_##V##_3 }, name }
+
+// GCC vector extensions; the generic ones are lowered to scalar code where
+// the target has no 16-byte vectors
+typedef double d2v __attribute__((vector_size(16)));
+typedef float f4v __attribute__((vector_size(16)));
+KERNELS(double, d2v, )
+KERNELS(float, f4v, )
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define HAVE_X86_KERNELS
+typedef double d4v __attribute__((vector_size(32)));
+typedef float f8v __attribute__((vector_size(32)));
+typedef double d8v __attribute__((vector_size(64)));
+typedef float f16v __attribute__((vector_size(64)));
+KERNELS(double, d4v, __attribute__((target("avx2,fma"))))
+KERNELS(float, f8v, __attribute__((target("avx2,fma"))))
+KERNELS(double, d8v, __attribute__((target("avx512f"))))
+KERNELS(float, f16v, __attribute__((target("avx512f"))))
+#endif
+
+template<typename T>
+const Kernels<T>& select(const Kernels<T>& avx512, const Kernels<T>& avx2, const Kernels<T>& generic)
+{
+#ifdef HAVE_X86_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+    return avx512;
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    return avx2;
+#endif
+  return generic;
+}
+
+const Kernels<double>& doubleKernels()
+{
+  static const Kernels<double> generic = TABLE(double, d2v, "generic");
+#ifdef HAVE_X86_KERNELS
+  static const Kernels<double> avx2 = TABLE(double, d4v, "avx2"), avx512 = TABLE(double, d8v, "avx512");
+  static const Kernels<double>& chosen = select(avx512, avx2, generic);
+#else
+  static const Kernels<double>& chosen = generic;
+#endif
+  return chosen;
+}
+
+const Kernels<float>& floatKernels()
+{
+  static const Kernels<float> generic = TABLE(float, f4v, "generic");
+#ifdef HAVE_X86_KERNELS
+  static const Kernels<float> avx2 = TABLE(float, f8v, "avx2"), avx512 = TABLE(float, f16v, "avx512");
+  static const Kernels<float>& chosen = select(avx512, avx2, generic);
+#else
+  static const Kernels<float>& chosen = generic;
+#endif
+  return chosen;
+}
+
+}
+
+void allPairsRepulsion(const double* const x[], size_t dim, int n, int lo, int hi, double* const f[])
+{
+  doubleKernels().fn[dim](x, n, lo, hi, f);
+}
+
+void allPairsRepulsion(const float* const x[], size_t dim, int n, int lo, int hi, float* const f[])
+{
+  floatKernels().fn[dim](x, n, lo, hi, f);
+}
+
+const char* allPairsRepulsionKernel()
+{
+  return doubleKernels().name;
+}
@@ -0,0 +1,137 @@
+#ifndef REPULSION_HH
+#define REPULSION_HH
+
+#include "Core.hh"
+#include "Fmm.hh"
+#include "Grid.hh"
+#include "KdTree.hh"
+#include "MortonTree.hh"
+#include "Parallel.hh"
+
+// Exact repulsion over positions stored by coordinate: for u in [lo, hi),
+//   f[d][u] = sum of (x[d][u] - x[d][v]) / |x_u - x_v|^2
+// over every v with x_v != x_u. Picks an AVX-512, AVX2 or portable kernel
+// from the CPU features on first use. dim is 1, 2 or 3.
+void allPairsRepulsion(const double* const x[], size_t dim, int n, int lo, int hi, double* const f[]);
+void allPairsRepulsion(const float* const x[], size_t dim, int n, int lo, int hi, float* const f[]);
+// name of the kernel chosen at runtime
+const char* allPairsRepulsionKernel();
+
+// Structure-of-arrays buffers for allPairsRepulsion, kept by a layout engine
+template<typename T, size_t Dim>
+struct AllPairsRepulsion
+{
+  static_assert(1 <= Dim && Dim <= 3, "kernels exist for 1 to 3 dimensions");
+
+  // force(u) then holds the unscaled repulsion on every vertex
+  void operator()(const vector<Vector<T, Dim>>& pos, int threads) {
+    int n = pos.size();
+    STATS_COUNT(COUNTER_LEAF_PAIRS, long(n) * (n - 1));
+    const T* xs[Dim];
+    T* fs[Dim];
+    for (size_t dim = 0; dim < Dim; dim++) {
+      x[dim].resize(n);
+      f[dim].resize(n);
+      for (int u = 0; u < n; u++)
+        x[dim][u] = pos[u][dim];
+      xs[dim] = x[dim].data();
+      fs[dim] = f[dim].data();
+    }
+    parallelFor(threads, (n + tile - 1) / tile, [&](int b) {
+      allPairsRepulsion(xs, Dim, n, b * tile, min(n, (b + 1) * tile), fs);
+    }, 1);
+  }
+  Vector<T, Dim> force(int u) const {
+    Vector<T, Dim> res;
+    for (size_t dim = 0; dim < Dim; dim++)
+      res[dim] = f[dim][u];
+    return res;
+  }
+
+  static const int tile = 64;
+  array<vector<T>, Dim> x, f;
+};
+
+enum RepulsionMethod { REPULSION_EXACT, REPULSION_KDTREE, REPULSION_FMM, REPULSION_MORTON, REPULSION_GRID };
+
+// Repulsive field of the current positions, unscaled: on every u, the sum
+// over v of (x_u - x_v) / |x_u - x_v|^2, exact or approximated, or only
+// over the v closer than `cutoff' with the cell grid. Layout
+// engines keep one and update() it once per iteration. With the Morton tree
+// they should also renumber their vertices whenever reorder() says so.
+template<typename T, size_t Dim>
+struct Repulsion
+{
+  Repulsion()
+    : method(REPULSION_KDTREE)
+      , alpha(1.5)
+      , order(12)
+      , cutoff(numeric_limits<T>::max())
+      , reorder_interval(10)
+      , updates(0) {}
+  // `rebuild' when the vertex set changed since the previous call
+  void update(const vector<Vector<T, Dim>>& pos, bool rebuild, int threads) {
+    updates = rebuild ? 0 : updates + 1;
+    // exact and multipole sums are done here, the others build a structure
+    STATS_PHASE(effective() == REPULSION_EXACT || effective() == REPULSION_FMM ? PHASE_REPULSION : PHASE_BUILD);
+    switch (effective()) {
+    case REPULSION_EXACT:
+      exact(pos, threads);
+      break;
+    case REPULSION_FMM:
+      fmm.order = order;
+      fmm.threads = threads;
+      fmm.evaluate(pos);
+      break;
+    case REPULSION_MORTON:
+      morton.alpha = alpha;
+      morton.threads = threads;
+      morton.build(pos);
+      break;
+    case REPULSION_GRID:
+      grid.threads = threads;
+      grid.build(pos, cutoff);
+      break;
+    default:
+      kd.alpha = alpha;
+      kd.threads = threads;
+      kd.build(pos);
+    }
+  }
+  Vector<T, Dim> operator()(const vector<Vector<T, Dim>>& pos, int u) const {
+    switch (effective()) {
+    case REPULSION_EXACT: return exact.force(u);
+    case REPULSION_FMM: return fmm.force(u);
+    case REPULSION_MORTON: return morton.getRepulsive(pos[u]);
+    case REPULSION_GRID: return grid.getRepulsive(pos[u]);
+    default: return kd.getRepulsive(pos[u]);
+    }
+  }
+  // Morton order of the positions of the last update(), every
+  // reorder_interval updates; NULL otherwise
+  const vector<int>* reorder() const {
+    return effective() == REPULSION_MORTON && updates % reorder_interval == 0 ? &morton.order() : NULL;
+  }
+  // the multipole method falls back to the k-d tree outside the plane
+  RepulsionMethod effective() const {
+    return method == REPULSION_FMM && ! Fmm<T, Dim>::available ? REPULSION_KDTREE : method;
+  }
+
+  RepulsionMethod method;
+  // trees: Barnes-Hut opening criterion
+  T alpha;
+  // multipole: expansion order
+  int order;
+  // grid: interaction range, set by the layout from its edge length
+  T cutoff;
+  int reorder_interval;
+  KdTree<T, Dim> kd;
+  MortonTree<T, Dim> morton;
+  CellGrid<T, Dim> grid;
+  AllPairsRepulsion<T, Dim> exact;
+  Fmm<T, Dim> fmm;
+protected:
+  int updates;
+};
+
+#endif /* end of include guard: REPULSION_HH */
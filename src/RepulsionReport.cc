@@ -0,0 +1,84 @@
+// Error and time of the approximate repulsion methods against the exact sum
+//   repulsion-report [n...]
+// on uniform and clustered random points. The error is the relative RMS
+// error of the force field.
+#include <chrono>
+#include <random>
+#include "Core.hh"
+#include "Repulsion.hh"
+
+typedef Vector<double, 2> V;
+
+static double seconds(std::chrono::steady_clock::time_point since)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - since).count();
+}
+
+static void report(const char* method, const vector<V>& pos, Repulsion<double, 2>& rep, const AllPairsRepulsion<double, 2>& exact)
+{
+  auto start = std::chrono::steady_clock::now();
+  rep.update(pos, true, 1);
+  vector<V> f(pos.size());
+  for (size_t u = 0; u < pos.size(); u++)
+    f[u] = rep(pos, u);
+  double t = seconds(start), num = 0, den = 0;
+  for (size_t u = 0; u < pos.size(); u++) {
+    num += (f[u] - exact.force(u)).norm2();
+    den += exact.force(u).norm2();
+  }
+  printf("  %-12s %9.4fs  %.2e\n", method, t, den > 0 ? sqrt(num / den) : 0.0);
+}
+
+int main(int argc, char* argv[])
+{
+  vector<int> sizes;
+  for (int i = 1; i < argc; i++)
+    sizes.push_back(atoi(argv[i]));
+  if (sizes.empty())
+    sizes = {1000, 10000, 50000};
+
+  std::mt19937 rng(1);
+  for (int n : sizes)
+    for (int clustered = 0; clustered < 2; clustered++) {
+      std::uniform_real_distribution<double> uniform(0, 400);
+      std::normal_distribution<double> normal(0, 20);
+      vector<V> pos(n);
+      for (auto& x : pos)
+        if (clustered) {
+          // 8 Gaussian clusters
+          int c = rng() % 8;
+          x[0] = 50 + 300 * ((c * 5) % 8) / 8.0 + normal(rng);
+          x[1] = 50 + 300 * ((c * 3) % 8) / 8.0 + normal(rng);
+        } else {
+          x[0] = uniform(rng);
+          x[1] = uniform(rng);
+        }
+
+      printf("n = %d, %s\n", n, clustered ? "clustered" : "uniform");
+      AllPairsRepulsion<double, 2> exact;
+      auto start = std::chrono::steady_clock::now();
+      exact(pos, 1);
+      printf("  %-12s %9.4fs\n", "exact", seconds(start));
+
+      char name[32];
+      Repulsion<double, 2> rep;
+      rep.method = REPULSION_KDTREE;
+      for (double alpha : {1.0, 1.5, 2.0}) {
+        rep.alpha = alpha;
+        snprintf(name, sizeof name, "kd %.1f", alpha);
+        report(name, pos, rep, exact);
+      }
+      rep.method = REPULSION_MORTON;
+      for (double alpha : {1.0, 1.5, 2.0}) {
+        rep.alpha = alpha;
+        snprintf(name, sizeof name, "morton %.1f", alpha);
+        report(name, pos, rep, exact);
+      }
+      rep.method = REPULSION_FMM;
+      for (int order : {4, 8, 12, 16, 24}) {
+        rep.order = order;
+        snprintf(name, sizeof name, "fmm %d", order);
+        report(name, pos, rep, exact);
+      }
+    }
+}
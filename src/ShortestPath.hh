@@ -0,0 +1,155 @@
+#ifndef SHORTESTPATH_HH
+#define SHORTESTPATH_HH
+
+#include "Core.hh"
+#include "Parallel.hh"
+
+// Single-source shortest paths. dist[v] is numeric_limits<T>::max() if v is
+// unreachable. Scratch buffers are passed in so that callers can reuse them.
+
+// The scratch of one search at a time, for callers that keep it between
+// calls
+template<typename T>
+struct SearchBuffers
+{
+  vector<T> dist, nearest;
+  vector<int> queue;
+  vector<pair<T, int>> heap;
+};
+
+// every edge weighs `w'
+template<typename T>
+void bfs(const Graph<T>& g, int s, T w, vector<T>& dist, vector<int>& queue)
+{
+  dist.assign(g.n, numeric_limits<T>::max());
+  queue.resize(g.n);
+  int head = 0, tail = 0;
+  dist[s] = 0;
+  queue[tail++] = s;
+  while (head < tail) {
+    int u = queue[head++];
+    for (int j = g.offset[u]; j < g.offset[u + 1]; j++)
+      if (dist[g.adj[j]] == numeric_limits<T>::max()) {
+        dist[g.adj[j]] = dist[u] + w;
+        queue[tail++] = g.adj[j];
+      }
+  }
+}
+
+// binary heap with lazy deletion
+template<typename T>
+void dijkstra(const Graph<T>& g, int s, vector<T>& dist, vector<pair<T, int>>& heap)
+{
+  auto later = [](const pair<T, int>& l, const pair<T, int>& r) { return l.first > r.first; };
+  dist.assign(g.n, numeric_limits<T>::max());
+  heap.clear();
+  dist[s] = 0;
+  heap.push_back(std::make_pair(T(0), s));
+  while (! heap.empty()) {
+    std::pop_heap(heap.begin(), heap.end(), later);
+    T d = heap.back().first;
+    int u = heap.back().second;
+    heap.pop_back();
+    if (d > dist[u]) continue;
+    for (int j = g.offset[u]; j < g.offset[u + 1]; j++) {
+      T nd = d + g.weight[j];
+      if (nd < dist[g.adj[j]]) {
+        dist[g.adj[j]] = nd;
+        heap.push_back(std::make_pair(nd, g.adj[j]));
+        std::push_heap(heap.begin(), heap.end(), later);
+      }
+    }
+  }
+}
+
+template<typename T>
+bool uniformWeights(const Graph<T>& g)
+{
+  for (size_t j = 1; j < g.weight.size(); j++)
+    if (g.weight[j] != g.weight[0])
+      return false;
+  return true;
+}
+
+// Whether all-pairs shortest paths are cheaper by Floyd-Warshall (n^3) than
+// by one search per source (n m log n)
+template<typename T>
+bool preferFloydWarshall(const Graph<T>& g)
+{
+  return double(g.adj.size()) * std::log2(g.n + 1.0) >= double(g.n) * g.n;
+}
+
+// k max-min landmarks: each one is the vertex farthest from those chosen so
+// far. pd[size_t(p) * n + v] is the distance from the p-th, piv[p], to v.
+// The searches run one after another, as each source is only known once
+// the searches from all earlier ones are done.
+template<typename T>
+void maxMinPivots(const Graph<T>& g, int k, vector<int>& piv, vector<T>& pd, SearchBuffers<T>& buf)
+{
+  int n = g.n;
+  bool uniform = uniformWeights(g);
+  vector<T> &dist = buf.dist, &nearest = buf.nearest;
+  vector<int>& queue = buf.queue;
+  vector<pair<T, int>>& heap = buf.heap;
+  nearest.assign(n, numeric_limits<T>::max());
+  piv.clear();
+  pd.resize(size_t(k) * n);
+  int next = 0;
+  for (int p = 0; p < k; p++) {
+    piv.push_back(next);
+    if (uniform)
+      bfs(g, next, g.weight.empty() ? T(1) : g.weight[0], dist, queue);
+    else
+      dijkstra(g, next, dist, heap);
+    std::copy(dist.begin(), dist.end(), pd.begin() + size_t(p) * n);
+    for (int v = 0; v < n; v++)
+      nearest[v] = min(nearest[v], dist[v]);
+    // unreachable vertices are the farthest of all
+    next = std::max_element(nearest.begin(), nearest.end()) - nearest.begin();
+    if (nearest[next] == 0)
+      for (next = 0; next < n && std::find(piv.begin(), piv.end(), next) != piv.end(); next++);
+  }
+}
+
+template<typename T>
+void maxMinPivots(const Graph<T>& g, int k, vector<int>& piv, vector<T>& pd)
+{
+  SearchBuffers<T> buf;
+  maxMinPivots(g, k, piv, pd, buf);
+}
+
+// Call row(s, dist) with the distances from every source s. Sources are
+// spread over `threads' threads, each searching with its own element of
+// `buffers', so row must only touch state owned by s. Searches are
+// breadth-first when all edges weigh the same.
+template<typename T, typename F>
+void allPairsShortestPaths(const Graph<T>& g, int threads, F row, vector<SearchBuffers<T>>& buffers)
+{
+  bool uniform = uniformWeights(g);
+  const int chunk = 16;
+  int blocks = (g.n + chunk - 1) / chunk;
+  threads = max(1, min(threads, blocks));
+  if (buffers.size() < size_t(threads))
+    buffers.resize(threads);
+  std::atomic<int> next(0);
+  parallelRun(threads, [&](int t) {
+    SearchBuffers<T>& buf = buffers[t];
+    for (int b; (b = next++) < blocks; )
+      for (int s = b * chunk; s < min(g.n, (b + 1) * chunk); s++) {
+        if (uniform)
+          bfs(g, s, g.weight.empty() ? T(1) : g.weight[0], buf.dist, buf.queue);
+        else
+          dijkstra(g, s, buf.dist, buf.heap);
+        row(s, buf.dist);
+      }
+  });
+}
+
+template<typename T, typename F>
+void allPairsShortestPaths(const Graph<T>& g, int threads, F row)
+{
+  vector<SearchBuffers<T>> buffers;
+  allPairsShortestPaths(g, threads, row, buffers);
+}
+
+#endif /* end of include guard: SHORTESTPATH_HH */
@@ -0,0 +1,119 @@
+#ifndef SPRINGELECTRICAL_HH
+#define SPRINGELECTRICAL_HH
+
+#include <cmath>
+#include "Core.hh"
+#include "Cooling.hh"
+#include "Parallel.hh"
+#include "Repulsion.hh"
+
+// Spring-electrical layout: every pass sums on each vertex the repulsive
+// field of all others and the pull of its neighbours, then moves it along the
+// resultant by at most the step length of `Schedule' (Cooling). The force
+// model is a compile-time policy `Forces' with
+//   T repulsion(T k, T c, int degree) const
+// the factor on the field sum of (x_u - x_v) / |x_u - x_v|^2 on a vertex of
+// that degree, and
+//   Vector<T, Dim> attraction(const Vector<T, Dim>& dist, T k, T c, int degree) const
+// the pull of one neighbour at offset `dist', for natural spring length k
+// and force constant c. Both are inlined into the passes.
+template<typename T, size_t Dim, typename Forces, typename Schedule = Cooling<T>>
+struct SpringElectrical : ForceDirectedDrawing<T, Dim>
+{
+  using ForceDirectedDrawing<T, Dim>::space;
+  using ForceDirectedDrawing<T, Dim>::threads;
+
+  SpringElectrical(const array<T, Dim>& space)
+    : ForceDirectedDrawing<T, Dim>(space)
+      , separation_constant(2)
+      , force_constant(0.01)
+      , iterations(50) {}
+  virtual SpringElectrical* clone() const { return new SpringElectrical(*this); }
+  virtual void operator()(const Graph<T>& g, vector<Vector<T, Dim>>& pos) {
+    T k = separation_constant * std::pow(accumulate(space.begin(), space.end(), T(1), std::multiplies<T>()) / T(g.n), T(1) / T(Dim));
+    this->iterations_run = 0;
+    this->interrupted = false;
+    // a warm start only smooths the given layout
+    layout(g, pos, k, this->warm ? k : *std::min_element(space.begin(), space.end()), iterations);
+    if (! this->warm)
+      normalizeToSpace(pos, space);
+  }
+
+  T separation_constant, force_constant;
+  int iterations;
+
+  Forces forces;
+  Repulsion<T, Dim> repulsion;
+  Schedule cooling;
+
+protected:
+  VertexOrder<T, Dim> renumber;
+  // per vertex, kept between calls
+  vector<Vector<T, Dim>> vel;
+  vector<T> moved, energy;
+
+  // at most `iterations' passes with natural spring length `k', cooling
+  // from `temperature', none once the control has stopped the layout; adds
+  // the passes made to iterations_run. Progress is reported if `report'.
+  void layout(const Graph<T>& g, vector<Vector<T, Dim>>& pos, T k, T temperature, int iterations, bool report = true) {
+    vel.resize(g.n);
+    moved.resize(g.n);
+    energy.resize(g.n);
+    T c = force_constant;
+
+    // the original Fruchterman-Reingold range of repulsion, for the grid
+    repulsion.cutoff = 2 * k;
+    renumber.reset(g);
+    cooling.start(temperature, iterations, k);
+    for (bool more = iterations > 0 && ! this->expired(); more; ) {
+      T t = cooling.current();
+      repulsion.update(pos, cooling.first(), threads);
+      if (auto order = repulsion.reorder())
+        renumber.apply(*order, pos, threads);
+      const Graph<T>& g = renumber.get();
+      // each vertex only writes its own velocity
+      auto repel = [&](int u) {
+        if (this->mobility(renumber.original(u)) > 0)
+          vel[u] = repulsion(pos, u) * forces.repulsion(k, c, g.degree(u));
+        else
+          vel[u].fill(T(0));
+      };
+      auto attract = [&](int u) {
+        if (this->mobility(renumber.original(u)) == 0) return;
+        for (int j = g.offset[u]; j < g.offset[u + 1]; j++)
+          if (g.adj[j] != u)
+            vel[u] += forces.attraction(pos[g.adj[j]] - pos[u], k, c, g.degree(u));
+      };
+#ifdef ENABLE_STATS
+      // two passes only so that each can be timed
+      {
+        STATS_PHASE(PHASE_REPULSION);
+        parallelFor(threads, g.n, repel);
+      }
+      {
+        STATS_PHASE(PHASE_ATTRACTION);
+        parallelFor(threads, g.n, attract);
+      }
+#else
+      parallelFor(threads, g.n, [&](int u) { repel(u); attract(u); });
+#endif
+      {
+        STATS_PHASE(PHASE_DISPLACEMENT);
+        parallelFor(threads, g.n, [&](int u) {
+          energy[u] = vel[u].norm2();
+          moved[u] = min(sqrt(energy[u]), t) * this->mobility(renumber.original(u));
+          if (moved[u] > 0)
+            pos[u] += vel[u].unit() * moved[u];
+        });
+      }
+      T e = accumulate(energy.begin(), energy.end(), T(0));
+      STATS_ITERATION(e, g.n ? *std::max_element(moved.begin(), moved.end()) : T(0));
+      more = cooling.next(accumulate(moved.begin(), moved.end(), T(0)), e, g.n);
+      more = this->proceed(pos, this->iterations_run + cooling.passes(), renumber.labels(), report) && more;
+    }
+    renumber.restore(pos);
+    this->iterations_run += cooling.passes();
+  }
+};
+
+#endif /* end of include guard: SPRINGELECTRICAL_HH */
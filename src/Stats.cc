@@ -0,0 +1,94 @@
+#include "Stats.hh"
+
+#ifdef ENABLE_STATS
+
+static const char* phase_names[] = {"apsp", "init", "build", "repulsion", "attraction", "displacement", "normalization"};
+static const char* counter_names[] = {"nodes_visited", "leaf_pairs", "approximations", "newton_steps", "pivots"};
+
+Stats::Local::Local()
+{
+  for (auto& c : counts)
+    c = 0;
+}
+
+Stats::Local::~Local()
+{
+  flush();
+}
+
+// only touches the totals if there is something to add, as pooled workers
+// exit after them
+void Stats::Local::flush()
+{
+  for (int c = 0; c < COUNTER_COUNT; c++)
+    if (counts[c]) {
+      global().counts[c] += counts[c];
+      counts[c] = 0;
+    }
+}
+
+Stats::Local& Stats::local()
+{
+  static thread_local Local l;
+  return l;
+}
+
+Stats::Stats()
+{
+  for (auto& x : nanoseconds)
+    x = 0;
+  for (auto& x : counts)
+    x = 0;
+}
+
+Stats& Stats::global()
+{
+  static Stats s;
+  return s;
+}
+
+void Stats::iteration(double energy, double max_displacement)
+{
+  std::lock_guard<std::mutex> g(lock);
+  iterations.emplace_back(energy, max_displacement);
+}
+
+double Stats::seconds(StatsPhase phase) const
+{
+  return nanoseconds[phase] * 1e-9;
+}
+
+long Stats::counter(StatsCounter c) const
+{
+  return counts[c] + local().counts[c];
+}
+
+void Stats::reset()
+{
+  for (auto& x : nanoseconds)
+    x = 0;
+  for (int c = 0; c < COUNTER_COUNT; c++) {
+    counts[c] = 0;
+    local().counts[c] = 0;
+  }
+  std::lock_guard<std::mutex> g(lock);
+  iterations.clear();
+}
+
+void Stats::writeJSON(FILE* f) const
+{
+  fprintf(f, "{\n  \"phases\": {");
+  for (int p = 0; p < PHASE_COUNT; p++)
+    fprintf(f, "%s\"%s\": %.6f", p ? ", " : "", phase_names[p], seconds(StatsPhase(p)));
+  fprintf(f, "},\n  \"counters\": {");
+  for (int c = 0; c < COUNTER_COUNT; c++)
+    fprintf(f, "%s\"%s\": %ld", c ? ", " : "", counter_names[c], counter(StatsCounter(c)));
+  long pivots = counter(COUNTER_PIVOTS);
+  fprintf(f, ", \"newton_steps_per_pivot\": %.3f},\n  \"iterations\": [", pivots ? double(counter(COUNTER_NEWTON_STEPS)) / pivots : 0.0);
+  std::lock_guard<std::mutex> g(lock);
+  for (size_t i = 0; i < iterations.size(); i++)
+    fprintf(f, "%s\n    {\"energy\": %.9g, \"max_displacement\": %.9g}", i ? "," : "", iterations[i].first, iterations[i].second);
+  fprintf(f, "%s]\n}\n", iterations.empty() ? "" : "\n  ");
+}
+
+#endif
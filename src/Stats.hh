@@ -0,0 +1,102 @@
+#ifndef STATS_HH
+#define STATS_HH
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+#include <stdio.h>
+
+// Where a layout spends its time: phase timers, event counters and the
+// energy of every iteration, collected when configured with --enable-stats
+// and written by force --stats json. Otherwise the STATS_* macros expand to
+// nothing and their arguments are not evaluated.
+
+enum StatsPhase { PHASE_APSP, PHASE_INIT, PHASE_BUILD, PHASE_REPULSION, PHASE_ATTRACTION, PHASE_DISPLACEMENT, PHASE_NORMALIZATION, PHASE_COUNT };
+enum StatsCounter { COUNTER_NODES_VISITED, COUNTER_LEAF_PAIRS, COUNTER_APPROXIMATIONS, COUNTER_NEWTON_STEPS, COUNTER_PIVOTS, COUNTER_COUNT };
+
+#ifdef ENABLE_STATS
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Process-wide totals. Counters are bumped in a per-thread block that is
+// added to the totals when its thread exits, or when a pooled worker
+// (Parallel.hh) finishes a job, so that hot loops on different threads do
+// not contend.
+class Stats
+{
+public:
+  static Stats& global();
+  static void count(StatsCounter c, long n) { local().counts[c] += n; }
+  // adds the calling thread's counts to the totals
+  static void flush() { local().flush(); }
+  void add(StatsPhase phase, std::chrono::steady_clock::duration d) {
+    nanoseconds[phase] += std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+  }
+  // energy and largest vertex move of an iteration just made
+  void iteration(double energy, double max_displacement);
+  double seconds(StatsPhase phase) const;
+  // includes the calling thread, not other running ones
+  long counter(StatsCounter c) const;
+  void reset();
+  void writeJSON(FILE* f) const;
+
+protected:
+  struct Local
+  {
+    Local();
+    ~Local();
+    void flush();
+    long counts[COUNTER_COUNT];
+  };
+  static Local& local();
+
+  Stats();
+  std::atomic<long long> nanoseconds[PHASE_COUNT];
+  std::atomic<long> counts[COUNTER_COUNT];
+  mutable std::mutex lock;
+  std::vector<std::pair<double, double>> iterations;
+};
+
+// Adds the lifetime of the enclosing scope to a phase
+class StatsTimer
+{
+public:
+  StatsTimer(StatsPhase phase) : phase(phase), start(std::chrono::steady_clock::now()) {}
+  ~StatsTimer() { Stats::global().add(phase, std::chrono::steady_clock::now() - start); }
+protected:
+  StatsPhase phase;
+  std::chrono::steady_clock::time_point start;
+};
+
+// largest distance between corresponding points of two layouts
+template<typename P>
+double statsMaxMove(const std::vector<P>& a, const std::vector<P>& b)
+{
+  double r = 0;
+  for (size_t i = 0; i < a.size(); i++)
+    r = std::max(r, double(a[i].dist(b[i])));
+  return r;
+}
+
+#define STATS_CONCAT_(a, b) a##b
+#define STATS_CONCAT(a, b) STATS_CONCAT_(a, b)
+#define STATS_PHASE(phase) StatsTimer STATS_CONCAT(stats_timer_, __LINE__)(phase)
+#define STATS_COUNT(counter, n) Stats::count(counter, n)
+#define STATS_ITERATION(energy, max_displacement) Stats::global().iteration(energy, max_displacement)
+#define STATS_FLUSH() Stats::flush()
+
+#else
+
+#define STATS_PHASE(phase) ((void)0)
+#define STATS_COUNT(counter, n) ((void)0)
+#define STATS_ITERATION(energy, max_displacement) ((void)0)
+#define STATS_FLUSH() ((void)0)
+
+#endif
+
+#endif /* end of include guard: STATS_HH */
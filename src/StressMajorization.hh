@@ -0,0 +1,258 @@
+#ifndef STRESSMAJORIZATION_HH
+#define STRESSMAJORIZATION_HH
+
+#include "Core.hh"
+#include "DistanceMatrix.hh"
+#include "Parallel.hh"
+#include "ShortestPath.hh"
+
+// Minimizes the Kamada-Kawai stress sum w_ij (|x_i - x_j| - d_ij)^2 with
+// w_ij = d_ij^-2 by majorization (SMACOF), moving all vertices at once:
+//   x_i <- sum_j w_ij (x_j + d_ij (x_i - x_j) / |x_i - x_j|) / sum_j w_ij
+//
+// With `pivots' landmarks (Ortmann, Klimenta and Brandes, sparse stress) a
+// vertex only has terms to its graph neighbours and to the landmarks, a
+// landmark standing in for the vertices closest to it; memory and work per
+// iteration are O(k n + m). With pivots == 0 every pair is a term.
+// Either way the start is a pivot MDS embedding, unless a warm start gives one.
+template<typename T, size_t Dim>
+struct StressMajorization : ForceDirectedDrawing<T, Dim>
+{
+  using ForceDirectedDrawing<T, Dim>::space;
+  using ForceDirectedDrawing<T, Dim>::threads;
+
+  StressMajorization(const array<T, Dim>& space)
+    : ForceDirectedDrawing<T, Dim>(space)
+      , pivots(50)
+      , iterations(100)
+      , tolerance(1e-4) {}
+  virtual StressMajorization* clone() const { return new StressMajorization(*this); }
+  virtual void operator()(const Graph<T>& g, vector<Vector<T, Dim>>& pos) {
+    int n = g.n;
+    searches.resize(max(threads, 1));
+    bool sparse = 0 < pivots && pivots < n;
+    int k = min(n, max(sparse ? pivots : 50, int(Dim) + 1));
+    {
+      STATS_PHASE(PHASE_APSP);
+      maxMinPivots(g, k, piv, pd, searches[0]);
+    }
+    if (! this->warm) {
+      STATS_PHASE(PHASE_INIT);
+      pivotMDS(n, piv, pd, pos);
+    }
+
+    if (sparse) {
+      // a landmark's terms weigh as many vertices as are closest to it
+      region.assign(k, T(0));
+      for (int v = 0; v < n; v++) {
+        int best = 0;
+        for (int p = 1; p < k; p++)
+          if (pd[size_t(p) * n + v] < pd[size_t(best) * n + v])
+            best = p;
+        region[best] += 1;
+      }
+      majorize(n, pos, [&](int i, Term& term) {
+        for (int j = g.offset[i]; j < g.offset[i + 1]; j++)
+          if (g.adj[j] != i && g.weight[j] > 0)
+            term(g.adj[j], g.weight[j], T(1) / (g.weight[j] * g.weight[j]));
+        for (int p = 0; p < k; p++) {
+          T d = pd[size_t(p) * n + i];
+          if (piv[p] != i && d != numeric_limits<T>::max() && d > 0)
+            term(piv[p], d, region[p] / (d * d));
+        }
+      });
+    } else {
+      dist.resize(n);
+      {
+        STATS_PHASE(PHASE_APSP);
+        allPairsShortestPaths(g, threads, [&](int s, const vector<T>& d) {
+          for (int v = s + 1; v < n; v++)
+            dist.set(s, v, d[v]);
+        }, searches);
+      }
+      majorize(n, pos, [&](int i, Term& term) {
+        for (int j = 0; j < n; j++) {
+          T d = dist.get(i, j);
+          if (j != i && d != numeric_limits<T>::max() && d > 0)
+            term(j, d, T(1) / (d * d));
+        }
+      });
+    }
+
+    if (! this->warm)
+      normalizeToSpace(pos, space);
+  }
+
+  int pivots, iterations;
+  T tolerance;
+
+protected:
+  // kept between calls
+  vector<int> piv;
+  vector<T> pd; // pd[size_t(p) * n + v]: distance from the p-th landmark to v
+  vector<T> region, stress, c, row, col, b, next_e;
+  vector<vector<T>> eig;
+  vector<Vector<T, Dim>> next;
+  DistanceMatrix<T, T> dist;
+  vector<SearchBuffers<T>> searches;
+
+  // Brandes and Pich: double-center the squared landmark distances into
+  // C (n x k) and project onto the top eigenvectors of C^T C
+  void pivotMDS(int n, const vector<int>& piv, const vector<T>& pd, vector<Vector<T, Dim>>& pos) {
+    int k = piv.size();
+    c.assign(pd.begin(), pd.end());
+    T far(0);
+    for (T d : c)
+      if (d != numeric_limits<T>::max())
+        far = max(far, d);
+    for (T& d : c) {
+      if (d == numeric_limits<T>::max())
+        d = far;
+      d *= d;
+    }
+    row.assign(k, T(0));
+    col.assign(n, T(0));
+    T all(0);
+    for (int p = 0; p < k; p++)
+      for (int v = 0; v < n; v++) {
+        row[p] += c[size_t(p) * n + v] / n;
+        col[v] += c[size_t(p) * n + v] / k;
+      }
+    for (int p = 0; p < k; p++)
+      all += row[p] / k;
+    parallelFor(threads, k, [&](int p) {
+      for (int v = 0; v < n; v++)
+        c[size_t(p) * n + v] = T(-0.5) * (c[size_t(p) * n + v] - row[p] - col[v] + all);
+    }, 1);
+
+    b.resize(k * k);
+    parallelFor(threads, k, [&](int p) {
+      for (int q = 0; q < k; q++) {
+        T s(0);
+        for (int v = 0; v < n; v++)
+          s += c[size_t(p) * n + v] * c[size_t(q) * n + v];
+        b[p * k + q] = s;
+      }
+    }, 1);
+
+    // power iteration, deflating by the eigenvectors already found
+    eig.resize(Dim);
+    for (size_t dim = 0; dim < Dim; dim++) {
+      vector<T>& e = eig[dim];
+      e.resize(k);
+      for (int p = 0; p < k; p++)
+        e[p] = T(1) + T((p * 7 + dim * 3) % 11) / 11;
+      for (int it = 0; it < 200; it++) {
+        vector<T>& next = next_e;
+        next.assign(k, T(0));
+        for (int p = 0; p < k; p++)
+          for (int q = 0; q < k; q++)
+            next[p] += b[p * k + q] * e[q];
+        for (size_t prev = 0; prev < dim; prev++) {
+          T dot(0);
+          for (int p = 0; p < k; p++)
+            dot += next[p] * eig[prev][p];
+          for (int p = 0; p < k; p++)
+            next[p] -= dot * eig[prev][p];
+        }
+        T norm(0), change(0);
+        for (int p = 0; p < k; p++)
+          norm += next[p] * next[p];
+        norm = sqrt(norm);
+        if (norm == 0) break;
+        for (int p = 0; p < k; p++) {
+          next[p] /= norm;
+          change = max(change, std::abs(next[p] - e[p]));
+        }
+        e.swap(next);
+        if (change < 1e-9) break;
+      }
+    }
+    parallelFor(threads, n, [&](int v) {
+      for (size_t dim = 0; dim < Dim; dim++) {
+        T s(0);
+        for (int p = 0; p < k; p++)
+          s += c[size_t(p) * n + v] * eig[dim][p];
+        pos[v][dim] = s;
+      }
+    });
+  }
+
+  // Accumulates the update and the stress of vertex i over its terms
+  struct Term
+  {
+    Term(const vector<Vector<T, Dim>>& pos, int i) : pos(pos), i(i), den(0), stress(0), wdl(0), wll(0) { num.fill(T(0)); }
+    void operator()(int j, T d, T w) {
+      Vector<T, Dim> diff = pos[i] - pos[j];
+      T dist = diff.norm();
+      num += pos[j] * w;
+      if (dist > 0)
+        num += diff * (w * d / dist);
+      den += w;
+      stress += w * (dist - d) * (dist - d);
+      wdl += w * d * dist;
+      wll += w * dist * dist;
+    }
+    const vector<Vector<T, Dim>>& pos;
+    int i;
+    Vector<T, Dim> num;
+    // sums of w d |x_i - x_j| and w |x_i - x_j|^2, for the best scale
+    T den, stress, wdl, wll;
+  };
+
+  // Jacobi-style majorization sweeps; terms(i, term) calls term(j, d_ij, w_ij)
+  // for every term of vertex i
+  template<typename Terms>
+  void majorize(int n, vector<Vector<T, Dim>>& pos, Terms terms) {
+    next.resize(n);
+    stress.resize(n);
+    T last = numeric_limits<T>::max();
+    STATS_PHASE(PHASE_DISPLACEMENT);
+    // a warm start is in the units of the space: scale it to graph
+    // distances by the factor that minimizes the stress, and back at the end
+    T scale = 1;
+    if (this->warm) {
+      T wdl = 0, wll = 0;
+      for (int i = 0; i < n; i++) {
+        Term term(pos, i);
+        terms(i, term);
+        wdl += term.wdl;
+        wll += term.wll;
+      }
+      if (wdl > 0 && wll > 0)
+        scale = wdl / wll;
+      for (auto& x : pos)
+        x = x * scale;
+    }
+    this->iterations_run = 0;
+    this->interrupted = false;
+    for (int it = 0; it < iterations && ! this->expired(); it++) {
+      parallelFor(threads, n, [&](int i) {
+        Term term(pos, i);
+        terms(i, term);
+        next[i] = term.den > 0 ? term.num / term.den : pos[i];
+        if (this->mobility(i) != 1)
+          next[i] = pos[i] + (next[i] - pos[i]) * this->mobility(i);
+        stress[i] = term.stress;
+      });
+      pos.swap(next);
+      this->iterations_run++;
+      T cur = std::accumulate(stress.begin(), stress.end(), T(0));
+      STATS_ITERATION(cur, statsMaxMove(pos, next));
+      if (! this->proceed(pos, this->iterations_run)
+          || (last != numeric_limits<T>::max() && last - cur < tolerance * last))
+        break;
+      last = cur;
+    }
+    // hand the caller back its own buffer
+    if (this->iterations_run % 2) {
+      pos.swap(next);
+      pos.assign(next.begin(), next.end());
+    }
+    if (scale != 1)
+      for (auto& x : pos)
+        x = x / scale;
+  }
+};
+
+#endif /* end of include guard: STRESSMAJORIZATION_HH */
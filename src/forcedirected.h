@@ -0,0 +1,56 @@
+#ifndef FORCEDIRECTED_H
+#define FORCEDIRECTED_H
+
+/* C interface of libforcedirected; see ForceDirected.hh for the meaning of
+   the options and calls, which these mirror. No call lets an exception
+   through: one that runs out of memory fails as it does for bad arguments. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+  FD_FRUCHTERMAN_REINGOLD, FD_WALSHAW, FD_KAMADA_KAWAI, FD_MULTILEVEL_WALSHAW,
+  FD_STRESS_MAJORIZATION, FD_LINLOG, FD_FORCE_ATLAS2
+};
+enum { FD_INIT_CIRCLE, FD_INIT_HDE, FD_INIT_SPECTRAL };
+
+typedef struct fd_options
+{
+  int algorithm, dim, single;
+  double size[3];
+  int iterations, threads, initial, pack_components;
+} fd_options;
+
+typedef struct fd_snapshot
+{
+  const void* coords;
+  const int* label;
+  int n, pass;
+} fd_snapshot;
+
+/* nonzero to go on */
+typedef int (*fd_progress)(const fd_snapshot* snapshot, void* user);
+
+typedef struct fd_workspace fd_workspace;
+
+/* the defaults of force */
+void fd_options_init(fd_options* options);
+/* NULL for an unknown algorithm or initial layout, dim other than 2 or 3,
+   iterations, threads or a size used that is not positive, or no memory */
+fd_workspace* fd_workspace_new(const fd_options* options);
+void fd_workspace_free(fd_workspace* ws);
+
+/* the passes made, or -1 for a malformed graph or a failed layout */
+int fd_layout(fd_workspace* ws, int n, int m, const int* u, const int* v, const double* w, double* coords, int warm);
+void fd_set_budget(fd_workspace* ws, double seconds);
+void fd_cancel(fd_workspace* ws);
+/* 0, or -1 if f could not be set */
+int fd_set_progress(fd_workspace* ws, fd_progress f, void* user, int interval);
+int fd_interrupted(const fd_workspace* ws);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FORCEDIRECTED_H */